@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Canvas.hpp"
+
+#include <algorithm>
+
+#if !defined(CANVAS_NO_SIMD) && defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define CANVAS_NEON
+#elif !defined(CANVAS_NO_SIMD) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define CANVAS_SSE2
+#endif
+
+// dst * (0xff - a) + src * a over 0xff per 8-bit channel, rounded, two channels per multiply
+static inline u32 blend_pixel(u32 dst, u32 src, u32 a) {
+    u32 rb = (src & 0xff00ff) * a + (dst & 0xff00ff) * (0xff - a) + 0x800080;
+    rb = ((rb + ((rb >> 8) & 0xff00ff)) >> 8) & 0xff00ff;
+    u32 g = (src & 0xff00) * a + (dst & 0xff00) * (0xff - a) + 0x8000;
+    g = ((g + ((g >> 8) & 0xff00)) >> 8) & 0xff00;
+    return rb | g | (src & 0xff000000);
+}
+
+static inline void fill_row(u32 *row, u32 count, u32 color) {
+    u32 i = 0;
+#if defined(CANVAS_NEON)
+    uint32x4_t fill = vdupq_n_u32(color);
+    for ( ; i + 4 <= count; i += 4)
+        vst1q_u32(row + i, fill);
+#elif defined(CANVAS_SSE2)
+    __m128i fill = _mm_set1_epi32(color);
+    for ( ; i + 4 <= count; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + i), fill);
+#endif
+    for ( ; i < count; i++)
+        row[i] = color;
+}
+
+void Canvas::attach(u32 *pixels, u32 width, u32 height, u32 pitch) {
+    this->pixels = pixels;
+    this->width = width;
+    this->height = height;
+    this->pitch = pitch;
+    clear_dirty();
+}
+
+bool Canvas::clip(s32 &x, s32 &y, s32 &width, s32 &height) const {
+    if (x < 0) {
+        width += x;
+        x = 0;
+    }
+    if (y < 0) {
+        height += y;
+        y = 0;
+    }
+    width = std::min<s32>(width, static_cast<s32>(this->width) - x);
+    height = std::min<s32>(height, static_cast<s32>(this->height) - y);
+    return (pixels != nullptr) && (width > 0) && (height > 0);
+}
+
+void Canvas::fill_rect(s32 x, s32 y, s32 width, s32 height, u32 color) {
+    if (!clip(x, y, width, height))
+        return;
+    for (s32 row = 0; row < height; row++)
+        fill_row(pixels + (y + row) * pitch + x, width, color);
+    dirty = true;
+}
+
+void Canvas::blend_mask(const u8 *mask, s32 width, s32 height, s32 pitch, s32 x, s32 y, u32 color) {
+    s32 clip_x = x, clip_y = y;
+    if (!clip(clip_x, clip_y, width, height))
+        return;
+    mask += (clip_y - y) * pitch + (clip_x - x);
+
+    for (s32 row = 0; row < height; row++, mask += pitch) {
+        u32 *dst = pixels + (clip_y + row) * this->pitch + clip_x;
+        for (s32 col = 0; col < width; col++) {
+            // most of a glyph's box is either empty or fully covered
+            if (mask[col] == 0xff)
+                dst[col] = color;
+            else if (mask[col] != 0)
+                dst[col] = blend_pixel(dst[col], color, mask[col]);
+        }
+    }
+    dirty = true;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <switch/types.h>
+
+// software rasterizer over a linear RGBA8 framebuffer
+class Canvas {
+public:
+    void attach(u32 *pixels, u32 width, u32 height, u32 pitch);
+
+    // all drawing is clipped to the framebuffer and marks the canvas dirty
+    void fill_rect(s32 x, s32 y, s32 width, s32 height, u32 color);
+    // blend color over framebuffer using 8-bit coverage, pitch is in bytes
+    void blend_mask(const u8 *mask, s32 width, s32 height, s32 pitch, s32 x, s32 y, u32 color);
+
+    // whether anything was drawn since the last clear_dirty, libnx presents whole frames so no region is kept
+    bool is_dirty() const { return dirty; }
+    void clear_dirty() { dirty = false; }
+
+private:
+    // clip rectangle to framebuffer, false if nothing is left
+    bool clip(s32 &x, s32 &y, s32 &width, s32 &height) const;
+
+    u32 *pixels = nullptr;
+    u32 width = 0, height = 0;
+    // in pixels
+    u32 pitch = 0;
+    bool dirty = false;
+};
\ No newline at end of file
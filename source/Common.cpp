@@ -20,81 +20,189 @@
 */
 
 #include "Common.hpp"
+#include "Canvas.hpp"
+#include "CoreThread.hpp"
 #include "Key.hpp"
+#include "Progress.hpp"
 
 #include <machine/endian.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include <switch.h>
 
 namespace Common {
-    static u32 framebuf_width = 0;
     static Framebuffer fb;
     static u32 stride;
-    static u32 *framebuf;
+    static Canvas canvas;
     // FreeType vars
     static FT_Library library;
     static FT_Face face;
+    // printable ASCII rendered once by intro, bitmaps packed back to back in glyph_atlas
+    static std::vector<u8> glyph_atlas;
+    static Glyph glyphs[GLYPH_LAST - GLYPH_FIRST + 1];
+    // extent of the atlas above and below the baseline
+    static s32 glyph_ascent = 0, glyph_descent = 0;
+
+    // drawing queued by the main thread for the ui thread
+    struct DrawCommand {
+        enum Type {
+            DRAW_RECT,
+            DRAW_TEXT,
+            PROGRESS_BEGIN,
+            PROGRESS_END
+        } type;
+        u32 x, y, width, height, color;
+        char str[UI_TEXT_SIZE];
+    };
+
+    // single producer single consumer ring, indices only grow
+    static DrawCommand ui_queue[UI_QUEUE_SIZE];
+    static std::atomic<size_t> ui_head(0), ui_tail(0);
+    // shares the main thread's core and preempts it and the workers to draw
+    static std::unique_ptr<CoreThread> ui_thread;
+    // only touched by the main thread
+    static bool ui_running = false;
+    static std::atomic<bool> ui_stop(false);
+    // row showing Progress counters, 0 while no phase is running, and what it shows
+    static u32 progress_row = 0, progress_width = 0;
+    static u64 progress_shown[3];
+
+    void draw_glyph(const u8 *bitmap, u32 width, u32 rows, s32 pitch, s32 x, s32 y, u32 color) {
+        canvas.blend_mask(bitmap, width, rows, pitch, x, y, color);
+    }
 
-    void draw_glyph(FT_Bitmap *bitmap, u32 x, u32 y, u32 color) {
-        u32 framex, framey;
-        u8* imageptr = bitmap->buffer;
+    // load and render c into face->glyph
+    static bool render_glyph(FT_ULong c) {
+        FT_UInt glyph_index = FT_Get_Char_Index(face, c);
+        return (FT_Load_Glyph(face, glyph_index, FT_LOAD_COLOR) == 0) &&
+            (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL) == 0);
+    }
 
-        for (u32 tmpy = 0; tmpy < bitmap->rows; tmpy++) {
-            for (u32 tmpx = 0; tmpx < bitmap->width; tmpx++) {
-                framex = x + tmpx;
-                framey = y + tmpy;
+    static void cache_glyphs() {
+        FT_GlyphSlot slot = face->glyph;
+        glyph_atlas.clear();
 
-                // color calculation is extremely simplistic and only supports 0 or 0xff in each element for proper antialiasing
-                framebuf[framey * framebuf_width + framex] = RGBA8_MAXALPHA(imageptr[tmpx], imageptr[tmpx], imageptr[tmpx]) & color;
-            }
+        for (char c = GLYPH_FIRST; c <= GLYPH_LAST; c++) {
+            Glyph &glyph = glyphs[c - GLYPH_FIRST];
+            glyph = {};
+            glyph.offset = glyph_atlas.size();
+            if (!render_glyph(c))
+                continue;
 
-            imageptr += bitmap->pitch;
+            glyph.rendered = true;
+            glyph.width = slot->bitmap.width;
+            glyph.rows = slot->bitmap.rows;
+            glyph.left = slot->bitmap_left;
+            glyph.top = slot->bitmap_top;
+            glyph.advance_x = slot->advance.x >> 6;
+            glyph.advance_y = slot->advance.y >> 6;
+            glyph_ascent = std::max(glyph_ascent, glyph.top);
+            glyph_descent = std::max(glyph_descent, static_cast<s32>(glyph.rows) - glyph.top);
+            // pitch may be padded or negative, atlas rows are exactly width bytes
+            for (u32 row = 0; row < glyph.rows; row++) {
+                const u8 *src = slot->bitmap.buffer + static_cast<s32>(row) * slot->bitmap.pitch;
+                glyph_atlas.insert(glyph_atlas.end(), src, src + glyph.width);
+            }
         }
     }
 
+    static void push_command(const DrawCommand &command) {
+        size_t head = ui_head.load(std::memory_order_relaxed);
+        // ui thread drains the queue every frame, so this only waits when a burst overfills it
+        while (head - ui_tail.load(std::memory_order_acquire) == UI_QUEUE_SIZE)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ui_queue[head % UI_QUEUE_SIZE] = command;
+        ui_head.store(head + 1, std::memory_order_release);
+    }
+
     void draw_line(u32 x, u32 y, u32 length, u32 color) {
-        for (u32 tmpx = x; tmpx < x + length; tmpx++)
-            framebuf[y * framebuf_width + tmpx] = color;
+        draw_set_rect(x, y, length, 1, color);
     }
 
     void draw_set_rect(u32 x, u32 y, u32 width, u32 height, u32 color) {
-        for (u32 tmpy = y; tmpy < y + height; tmpy++)
-            draw_line(x, tmpy, width, color);
+        if (ui_running) {
+            push_command({DrawCommand::DRAW_RECT, x, y, width, height, color, {}});
+            return;
+        }
+        canvas.fill_rect(x, y, width, height, color);
     }
 
-    void draw_text(u32 x, u32 y, u32 color, const char *str) {
+    // advance of str up to the end of its line
+    static u32 line_width(const char *str) {
+        u32 width = 0;
+        for ( ; (*str != '\0') && (*str != '\n'); str++) {
+            if ((*str >= GLYPH_FIRST) && (*str <= GLYPH_LAST))
+                width += glyphs[*str - GLYPH_FIRST].advance_x;
+            else if (render_glyph(static_cast<u8>(*str)))
+                width += face->glyph->advance.x >> 6;
+        }
+        return width;
+    }
+
+    // text replaces what's under its line so a status can be redrawn in another color
+    static void clear_line(u32 x, u32 y, const char *str) {
+        canvas.fill_rect(x, y - glyph_ascent, line_width(str), glyph_ascent + glyph_descent, 0);
+    }
+
+    static void render_text(u32 x, u32 y, u32 color, const char *str) {
+        // no font before intro, the host build never loads one
+        if (face == NULL)
+            return;
         u32 tmpx = x;
-        FT_UInt glyph_index;
         FT_GlyphSlot slot = face->glyph;
 
-        for (size_t i = 0; i < strlen(str); i++) {
-            if (str[i] == '\n') {
+        clear_line(x, y, str);
+        for ( ; *str != '\0'; str++) {
+            if (*str == '\n') {
                 tmpx = x;
                 y += face->size->metrics.height / 64;
+                clear_line(x, y, str + 1);
                 continue;
             }
 
-            glyph_index = FT_Get_Char_Index(face, (FT_ULong)str[i]);
+            if ((*str >= GLYPH_FIRST) && (*str <= GLYPH_LAST)) {
+                const Glyph &glyph = glyphs[*str - GLYPH_FIRST];
+                if (!glyph.rendered)
+                    return;
+                draw_glyph(glyph_atlas.data() + glyph.offset, glyph.width, glyph.rows, glyph.width,
+                    tmpx + glyph.left, y - glyph.top, color);
+                tmpx += glyph.advance_x;
+                y += glyph.advance_y;
+                continue;
+            }
 
-            if (R_FAILED(FT_Load_Glyph(face, glyph_index, FT_LOAD_COLOR) ||
-                FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL) != 0))
-            {
+            // anything outside the atlas still goes through FreeType
+            if (!render_glyph(static_cast<u8>(*str)))
                 return;
-            }
 
-            draw_glyph(&slot->bitmap, tmpx + slot->bitmap_left, y - slot->bitmap_top, color);
+            draw_glyph(slot->bitmap.buffer, slot->bitmap.width, slot->bitmap.rows, slot->bitmap.pitch,
+                tmpx + slot->bitmap_left, y - slot->bitmap_top, color);
 
             tmpx += slot->advance.x >> 6;
             y += slot->advance.y >> 6;
         }
     }
 
+    void draw_text(u32 x, u32 y, u32 color, const char *str) {
+        if (ui_running) {
+            DrawCommand command = {DrawCommand::DRAW_TEXT, x, y, 0, 0, color, {}};
+            strncpy(command.str, str, sizeof(command.str) - 1);
+            push_command(command);
+            return;
+        }
+        render_text(x, y, color, str);
+    }
+
     void draw_text_with_time(u32 x, u32 y, u32 color, const char *str, const float time) {
         char time_str[32];
         sprintf(time_str, "%1.6f seconds", time);
@@ -116,11 +224,12 @@ namespace Common {
         FT_Init_FreeType(&library);
         FT_New_Memory_Face(library, static_cast<FT_Byte *>(font.address), font.size, 0, &face);
         FT_Set_Char_Size(face, 0, 6*64, 300, 300);
+        cache_glyphs();
 
         framebufferCreate(&fb, nwindowGetDefault(), FB_WIDTH, FB_HEIGHT, PIXEL_FORMAT_RGBA_8888, 2);
         framebufferMakeLinear(&fb);
-        framebuf = (u32 *)framebufferBegin(&fb, &stride);
-        framebuf_width = stride / sizeof(u32);
+        u32 *framebuf = (u32 *)framebufferBegin(&fb, &stride);
+        canvas.attach(framebuf, FB_WIDTH, FB_HEIGHT, stride / sizeof(u32));
         memset(framebuf, 0, stride*FB_HEIGHT);
         framebufferEnd(&fb);
 
@@ -146,6 +255,14 @@ namespace Common {
             wait_to_exit();
         }
 
+        reset_steps();
+        start_ui_thread();
+    }
+
+    void reset_steps() {
+        // everything between the header and the flag
+        draw_set_rect(0, 0x44, FB_WIDTH, 0x1b0 - 0x44, 0);
+
         draw_text(0x10, 0x060, CYAN, "Get Tegra keys...");
         draw_text(0x10, 0x080, CYAN, "Get keys from memory...");
         draw_text(0x10, 0x0a0, CYAN, "Get master keys...");
@@ -156,10 +273,10 @@ namespace Common {
         update_display();
     }
 
-    void get_tegra_keys(Key &sbk, Key &tsec, Key &tsec_root) {
+    void get_tegra_keys(Key &sbk, Key &tsec, Key &tsec_root, const char *dump_path) {
         // support Hekate dump
-        if (std::filesystem::exists("/backup")) {
-            for (auto &p : std::filesystem::recursive_directory_iterator("/backup")) {
+        if (std::filesystem::exists(dump_path)) {
+            for (auto &p : std::filesystem::recursive_directory_iterator(dump_path)) {
                 if (p.is_regular_file()) {
                     if (!sbk.found() && (p.file_size() == 0x2fc || p.file_size() == 0x300) &&
                         ((p.path().filename().string().substr(0, 5).compare("fuses") == 0) ||
@@ -205,6 +322,7 @@ namespace Common {
     }
 
     void wait_to_exit() {
+        stop_ui_thread();
         draw_text(0x10b, 0x24b, YELLOW, ">> Press + to exit <<");
 
         while(appletMainLoop()) {
@@ -222,9 +340,117 @@ namespace Common {
         appletUnlockExit();
     }
 
-    void update_display() {
+    static void present() {
+        // presenting converts the whole linear buffer, so skip it while nothing changed
+        if (!canvas.is_dirty())
+            return;
         framebufferBegin(&fb, &stride);
         framebufferEnd(&fb);
+        canvas.clear_dirty();
+    }
+
+    void update_display() {
+        // ui thread presents on its own
+        if (!ui_running)
+            present();
+    }
+
+    static void clear_progress() {
+        if (progress_width != 0)
+            canvas.fill_rect(UI_PROGRESS_X, progress_row - glyph_ascent, progress_width, glyph_ascent + glyph_descent, 0);
+        progress_width = 0;
+    }
+
+    static void run_command(const DrawCommand &command) {
+        switch (command.type) {
+            case DrawCommand::DRAW_RECT:
+                canvas.fill_rect(command.x, command.y, command.width, command.height, command.color);
+                break;
+            case DrawCommand::DRAW_TEXT:
+                render_text(command.x, command.y, command.color, command.str);
+                break;
+            case DrawCommand::PROGRESS_BEGIN:
+                progress_row = command.y;
+                std::fill(progress_shown, progress_shown + 3, 0);
+                break;
+            case DrawCommand::PROGRESS_END:
+                // results of the phase are queued right after and go in the same spot
+                clear_progress();
+                progress_row = 0;
+                break;
+        }
+    }
+
+    static void draw_progress() {
+        u64 counters[3] = {Progress::bytes_scanned, Progress::keys_found, Progress::tickets_processed};
+        if ((progress_row == 0) || std::equal(counters, counters + 3, progress_shown))
+            return;
+        std::copy(counters, counters + 3, progress_shown);
+
+        char progress_str[0x60];
+        int length = 0;
+        if (counters[0] != 0)
+            length += sprintf(progress_str + length, "%lu KiB scanned, ", counters[0] / 0x400);
+        if (counters[1] != 0)
+            length += sprintf(progress_str + length, "%lu keys found, ", counters[1]);
+        if (counters[2] != 0)
+            length += sprintf(progress_str + length, "%lu tickets processed, ", counters[2]);
+        // drop trailing separator
+        progress_str[std::max(length - 2, 0)] = '\0';
+
+        clear_progress();
+        render_text(UI_PROGRESS_X, progress_row, CYAN, progress_str);
+        progress_width = line_width(progress_str);
+    }
+
+    static void ui_loop() {
+        for (;;) {
+            // everything queued before stop was requested still gets drawn
+            bool stopping = ui_stop.load(std::memory_order_acquire);
+
+            size_t tail = ui_tail.load(std::memory_order_relaxed);
+            for (size_t head = ui_head.load(std::memory_order_acquire); tail != head; tail++) {
+                run_command(ui_queue[tail % UI_QUEUE_SIZE]);
+                ui_tail.store(tail + 1, std::memory_order_release);
+            }
+            draw_progress();
+            present();
+
+            if (stopping)
+                break;
+            std::this_thread::sleep_for(std::chrono::microseconds(1000000 / UI_FRAME_RATE));
+        }
+    }
+
+    void start_ui_thread() {
+        if (ui_running)
+            return;
+        ui_stop = false;
+        ui_thread.reset(new CoreThread(0, ui_loop, UI_THREAD_PRIORITY));
+        // without the thread everything is drawn synchronously as before
+        ui_running = ui_thread->started();
+        if (!ui_running)
+            ui_thread.reset();
+    }
+
+    void stop_ui_thread() {
+        if (!ui_running)
+            return;
+        ui_running = false;
+        ui_stop.store(true, std::memory_order_release);
+        ui_thread.reset();
+    }
+
+    void begin_progress(u32 y) {
+        if (!ui_running)
+            return;
+        Progress::reset();
+        push_command({DrawCommand::PROGRESS_BEGIN, 0, y, 0, 0, 0, {}});
+    }
+
+    void end_progress() {
+        if (ui_running)
+            push_command({DrawCommand::PROGRESS_END, 0, 0, 0, 0, 0, {}});
     }
 
     byte_vector key_string_to_byte_vector(std::string key_string) {
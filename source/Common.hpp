@@ -39,13 +39,37 @@
 #define FLAG_BLUE   RGBA8_MAXALPHA(0x00, 0x44, 0xff)
 #define FLAG_VIOLET RGBA8_MAXALPHA(0x76, 0x00, 0x89)
 
+// ui thread presents this often while the main thread works
+#define UI_FRAME_RATE 30
+// above the workers, Horizon doesn't time-slice a core between threads of equal priority
+#define UI_THREAD_PRIORITY 0x2b
+// draw calls the main thread can queue ahead of the ui thread
+#define UI_QUEUE_SIZE 64
+// longest string one queued draw_text keeps
+#define UI_TEXT_SIZE 0x100
+// Progress counters of a running phase are shown from here on its row
+#define UI_PROGRESS_X 0x2a0
+
+// range of characters kept in the glyph atlas
+#define GLYPH_FIRST ' '
+#define GLYPH_LAST  '~'
+
 class Key;
 
 typedef std::vector<u8> byte_vector;
 
 namespace Common {
-    // draw letter, called by draw_text
-    void draw_glyph(FT_Bitmap *bitmap, u32 x, u32 y, u32 color);
+    // prerendered character in the glyph atlas
+    struct Glyph {
+        size_t offset;
+        u32 width, rows;
+        s32 left, top;
+        s32 advance_x, advance_y;
+        bool rendered;
+    };
+
+    // blend letter over framebuffer, called by draw_text
+    void draw_glyph(const u8 *bitmap, u32 width, u32 rows, s32 pitch, s32 x, s32 y, u32 color);
     // draw horizontal line
     void draw_line(u32 x, u32 y, u32 length, u32 color);
     // draw filled rectangle
@@ -57,14 +81,26 @@ namespace Common {
     // overload for microseconds
     void draw_text_with_time(u32 x, u32 y, u32 color, const char *str, const int64_t time);
 
-    // init font and draw interface
+    // init font, draw interface and start the ui thread
     void intro();
-    // get tegra keys from payload dump
-    void get_tegra_keys(Key &sbk, Key &tsec, Key &tsec_root);
+    /*
+        draw calls from the main thread are queued for the ui thread while it runs,
+        so slow phases never wait on rendering and the screen keeps updating during them
+    */
+    void start_ui_thread();
+    // draw everything still queued and go back to drawing on the calling thread
+    void stop_ui_thread();
+    // show live Progress counters on row y until end_progress
+    void begin_progress(u32 y);
+    void end_progress();
+    // clear results of a previous run and draw pending steps
+    void reset_steps();
+    // get tegra keys from payload dump under dump_path
+    void get_tegra_keys(Key &sbk, Key &tsec, Key &tsec_root, const char *dump_path);
     // print exit
     void wait_to_exit();
 
-    // refresh display
+    // present what was drawn since the last refresh
     void update_display();
 
     // reads "<keyname> = <hexkey>" and returns byte vector
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CoreThread.hpp"
+
+#ifdef __SWITCH__
+
+CoreThread::CoreThread(size_t core, std::function<void()> fun, int priority) :
+    fun(fun)
+{
+    // out of threads on that core, any core beats not running at all
+    for (int cpuid : {static_cast<int>(core % APP_CORES), -2}) {
+        if (R_FAILED(threadCreate(&thread, &CoreThread::entry, this, NULL, CORE_THREAD_STACK_SIZE, priority, cpuid)))
+            continue;
+        if (R_SUCCEEDED(threadStart(&thread))) {
+            joinable = true;
+            return;
+        }
+        threadClose(&thread);
+    }
+}
+
+void CoreThread::entry(void *arg) {
+    static_cast<CoreThread *>(arg)->fun();
+}
+
+void CoreThread::join() {
+    if (!joinable)
+        return;
+    threadWaitForExit(&thread);
+    threadClose(&thread);
+    joinable = false;
+}
+
+#else
+
+CoreThread::CoreThread(size_t core, std::function<void()> fun, int priority) :
+    fun(fun),
+    joinable(true),
+    thread([this] { this->fun(); })
+{
+}
+
+void CoreThread::join() {
+    if (!joinable)
+        return;
+    thread.join();
+    joinable = false;
+}
+
+#endif
+
+CoreThread::~CoreThread() {
+    join();
+}
\ No newline at end of file
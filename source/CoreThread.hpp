@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <functional>
+
+#ifdef __SWITCH__
+    #include <switch.h>
+#else
+    #include <thread>
+#endif
+
+#include <switch/types.h>
+
+// cores an application may run threads on, the last one belongs to the system
+#define APP_CORES 3
+// stack of each thread, KeyScanner and Rsa2048 keep their buffers on the heap
+#define CORE_THREAD_STACK_SIZE 0x20000
+// same priority as the main thread, lower numbers preempt it
+#define CORE_THREAD_PRIORITY 0x2c
+
+/*
+    thread started on a given application core
+    std::thread on the console puts every thread on the caller's core, so workers wouldn't run in parallel
+*/
+class CoreThread {
+public:
+    // run fun on core % APP_CORES, priority only applies on the console
+    CoreThread(size_t core, std::function<void()> fun, int priority = CORE_THREAD_PRIORITY);
+    // joins if not joined yet
+    ~CoreThread();
+    CoreThread(const CoreThread &) = delete;
+    CoreThread &operator=(const CoreThread &) = delete;
+
+    // wait for fun to return
+    void join();
+    // false if no core could take the thread, fun won't run then
+    bool started() const { return joinable; }
+
+private:
+    std::function<void()> fun;
+    bool joinable = false;
+#ifdef __SWITCH__
+    static void entry(void *arg);
+
+    Thread thread;
+#else
+    // hosts schedule threads across cores on their own
+    std::thread thread;
+#endif
+};
\ No newline at end of file
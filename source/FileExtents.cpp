@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileExtents.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+#include <string.h>
+
+#include "fatfs/diskio.h"
+
+bool FileExtents::map(FIL &file) {
+    this->file = &file;
+    extents.clear();
+
+    // fatfs fills the fast seek table with (cluster count, first cluster) pairs, growing it until the chain fits
+    std::vector<DWORD> table(0x20);
+    FRESULT fr;
+    for (;;) {
+        table[0] = table.size();
+        file.cltbl = table.data();
+        fr = f_lseek(&file, CREATE_LINKMAP);
+        file.cltbl = NULL;
+        if ((fr != FR_NOT_ENOUGH_CORE) || (table[0] <= table.size()))
+            break;
+        table.resize(table[0]);
+    }
+    if (fr != FR_OK)
+        return false;
+
+    FATFS *fs = file.obj.fs;
+    u64 cluster_size = static_cast<u64>(fs->csize) * FF_MAX_SS, offset = 0;
+    for (size_t i = 1; (i + 1 < table.size()) && (table[i] != 0) && (offset < f_size(&file)); i += 2) {
+        u64 size = std::min<u64>(table[i] * cluster_size, f_size(&file) - offset);
+        extents.push_back({offset, size, fs->database + fs->csize * (table[i + 1] - 2)});
+        offset += size;
+    }
+    if (offset < f_size(&file)) {
+        extents.clear();
+        return false;
+    }
+    return true;
+}
+
+bool FileExtents::read(void *buffer, u64 offset, u64 size) {
+    if ((file == nullptr) || (offset + size > f_size(file)))
+        return false;
+    Profiler::count(Profiler::BYTES_READ, size);
+
+    if (extents.empty()) {
+        UINT bytes_read;
+        return !f_lseek(file, offset) && !f_read(file, buffer, size, &bytes_read) && (bytes_read == size);
+    }
+
+    BYTE *dest = static_cast<BYTE *>(buffer);
+    auto e = std::upper_bound(extents.begin(), extents.end(), offset, [](u64 o, const Extent &x) { return o < x.offset; }) - 1;
+    for ( ; size > 0; e++) {
+        u64 extent_offset = offset - e->offset;
+        u64 n = std::min(size, e->size - extent_offset);
+        DWORD sector = e->sector + extent_offset / FF_MAX_SS;
+        u64 sector_offset = extent_offset % FF_MAX_SS;
+
+        // whole sectors go straight into the caller's buffer in one read, partial ones through a bounce sector
+        for (u64 done = 0; done < n; ) {
+            if ((sector_offset == 0) && (n - done >= FF_MAX_SS)) {
+                UINT count = (n - done) / FF_MAX_SS;
+                if (disk_read(file->obj.fs->pdrv, dest + done, sector, count) != RES_OK)
+                    return false;
+                sector += count;
+                done += static_cast<u64>(count) * FF_MAX_SS;
+            } else {
+                BYTE temp[FF_MAX_SS];
+                u64 part = std::min<u64>(FF_MAX_SS - sector_offset, n - done);
+                if (disk_read(file->obj.fs->pdrv, temp, sector, 1) != RES_OK)
+                    return false;
+                memcpy(dest + done, temp + sector_offset, part);
+                sector++;
+                sector_offset = 0;
+                done += part;
+            }
+        }
+        dest += n;
+        offset += n;
+        size -= n;
+    }
+    return true;
+}
\ No newline at end of file
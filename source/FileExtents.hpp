@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <switch/types.h>
+
+#include "fatfs/ff.h"
+
+// contiguous runs of a fatfs file's clusters, so reads go to storage in as few pieces as its fragmentation allows
+class FileExtents {
+public:
+    // map cluster chain of open file, reads fall back to f_read if this fails
+    bool map(FIL &file);
+    // read size bytes at offset of the file, false if past its end or storage failed
+    bool read(void *buffer, u64 offset, u64 size);
+
+private:
+    struct Extent {
+        u64 offset;
+        u64 size;
+        // first sector on the volume
+        DWORD sector;
+    };
+
+    FIL *file = nullptr;
+    std::vector<Extent> extents;
+};
\ No newline at end of file
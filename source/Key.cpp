@@ -16,19 +16,20 @@
 
 #include "Key.hpp"
 
+#include "KeyScanner.hpp"
+
 #include <algorithm>
 #include <vector>
 
-#include "xxhash64.h"
-
 #include <switch.h>
 
-size_t Key::saved_key_count = 0;
+std::atomic<size_t> Key::saved_key_count(0);
 
-Key::Key(std::string name, u64 xx_hash, byte_vector hash, u8 length, byte_vector key) :
+Key::Key(std::string name, u64 xx_hash, u16 byte_sum, byte_vector hash, u8 length, byte_vector key) :
     key(key),
     name(name),
     xx_hash(xx_hash),
+    byte_sum(byte_sum),
     hash(hash),
     length(length)
 {
@@ -36,33 +37,39 @@ Key::Key(std::string name, u64 xx_hash, byte_vector hash, u8 length, byte_vector
 
 // init with hash only
 Key::Key(std::string name, u64 xx_hash, byte_vector hash, u8 length) :
-    Key(name, xx_hash, hash, length, {})
+    Key(name, xx_hash, {}, hash, length, {})
+{
+}
+
+// init with hash and byte sum for KeyScanner
+Key::Key(std::string name, u64 xx_hash, u16 byte_sum, byte_vector hash, u8 length) :
+    Key(name, xx_hash, byte_sum, hash, length, {})
 {
 }
 
 // init with key only
 Key::Key(std::string name, u8 length, byte_vector key) :
-    Key(name, {}, {}, length, key)
+    Key(name, {}, {}, {}, length, key)
 {
     is_found = true;
 }
 
 // nameless key
 Key::Key(byte_vector key, u8 length) :
-    Key({}, {}, {}, length, key)
+    Key({}, {}, {}, {}, length, key)
 {
     is_found = true;
 }
 
 // key to be assigned later
 Key::Key(std::string name, u8 length) :
-    Key(name, {}, {}, length, {})
+    Key(name, {}, {}, {}, length, {})
 {
 }
 
 // declare only
 Key::Key() :
-    Key({}, {}, {}, {}, {})
+    Key({}, {}, {}, {}, {}, {})
 {
 }
 
@@ -79,29 +86,50 @@ void Key::save_key(FILE *file) {
     saved_key_count++;
 }
 
+const Aes128Context &Key::get_aes_context() {
+    // key is public and may have been reassigned since the last call
+    if (!aes_context_valid || !std::equal(aes_context_key, aes_context_key + 0x10, key.begin())) {
+        std::copy(key.begin(), key.begin() + 0x10, aes_context_key);
+        aes128ContextCreate(&aes_context, aes_context_key, false);
+        aes_context_valid = true;
+    }
+    return aes_context;
+}
+
 byte_vector Key::aes_decrypt_ctr(const byte_vector &data, byte_vector iv) {
     byte_vector dest(data.size());
-    if (!found())
-        return dest;
+    aes_decrypt_ctr(data.data(), dest.data(), data.size(), iv.data());
+    return dest;
+}
+
+void Key::aes_decrypt_ctr(const u8 *src, u8 *dest, size_t size, const u8 *iv) {
+    if (!found() || (key.size() < 0x10)) {
+        std::fill(dest, dest + size, 0);
+        return;
+    }
 
     Aes128CtrContext con;
-    aes128CtrContextCreate(&con, key.data(), iv.data());
-    aes128CtrCrypt(&con, dest.data(), data.data(), data.size());
-    return dest;
+    aes128CtrContextCreate(&con, key.data(), iv);
+    aes128CtrCrypt(&con, dest, src, size);
 }
 
 byte_vector Key::aes_decrypt_ecb(const byte_vector &data) {
     byte_vector dest(data.size());
-    if (!found())
-        return dest;
-
-    Aes128Context con;
-    aes128ContextCreate(&con, key.data(), false);
-    for (size_t offset = 0; offset < data.size(); offset += 0x10)
-        aes128DecryptBlock(&con, dest.data() + offset, data.data() + offset);
+    aes_decrypt_ecb(data.data(), dest.data(), data.size());
     return dest;
 }
 
+void Key::aes_decrypt_ecb(const u8 *src, u8 *dest, size_t size) {
+    if (!found() || (key.size() < 0x10)) {
+        std::fill(dest, dest + size, 0);
+        return;
+    }
+
+    const Aes128Context &con = get_aes_context();
+    for (size_t offset = 0; offset < size; offset += 0x10)
+        aes128DecryptBlock(&con, dest + offset, src + offset);
+}
+
 byte_vector Key::cmac(byte_vector data) {
     byte_vector dest(data.size());
     if (!found())
@@ -111,14 +139,14 @@ byte_vector Key::cmac(byte_vector data) {
     return dest;
 }
 
-void Key::find_key(const byte_vector &buffer, size_t start) {
-    if ((buffer.size() == 0) || (found()))
+void Key::find_key(byte_span buffer, size_t start) {
+    if ((buffer.size == 0) || (found()))
         return;
 
     u8 temp_hash[0x20];
 
-    if (buffer.size() == length) {
-        sha256CalculateHash(temp_hash, buffer.data(), length);
+    if (buffer.size == length) {
+        sha256CalculateHash(temp_hash, buffer.data, length);
         if (!std::equal(hash.begin(), hash.end(), temp_hash))
             return;
         std::copy(buffer.begin(), buffer.begin() + length, std::back_inserter(key));
@@ -126,25 +154,27 @@ void Key::find_key(const byte_vector &buffer, size_t start) {
         return;
     }
 
-    // hash every length-sized byte chunk in buffer until it matches member hash
-    for (size_t i = start; i < buffer.size() - length; i++) {
-        if (xx_hash == XXHash64::hash(buffer.data() + i, length, 0)) {
-            // double-check sha256 since xxhash64 isn't as collision-safe
-            sha256CalculateHash(temp_hash, buffer.data() + i, length);
-            if (!std::equal(hash.begin(), hash.end(), temp_hash))
-                continue;
-            std::copy(buffer.begin() + i, buffer.begin() + i + length, std::back_inserter(key));
-            is_found = true;
-            break;
-        }
-    }
+    if (start >= buffer.size)
+        return;
+    KeyScanner scanner({this});
+    scanner.scan(buffer.data + start, buffer.size - start);
+    scanner.store();
 }
 
  byte_vector Key::generate_kek(Key &master_key, const Key &kek_seed, const Key &key_seed) {
-    Key kek(master_key.aes_decrypt_ecb(kek_seed.key), 0x10);
-    Key srcKek(kek.aes_decrypt_ecb(key), 0x10);
-    if (key_seed.found())
-        return srcKek.aes_decrypt_ecb(key_seed.key);
-    else
-        return srcKek.key;
+    u8 kek[0x10], src_kek[0x10], dest[0x10] = {};
+    if (!found() || (key.size() < 0x10) || (kek_seed.key.size() < 0x10))
+        return byte_vector(dest, dest + 0x10);
+
+    // intermediate keks are used once, so they go straight through local contexts
+    Aes128Context con;
+    master_key.aes_decrypt_ecb(kek_seed.key.data(), kek, 0x10);
+    aes128ContextCreate(&con, kek, false);
+    aes128DecryptBlock(&con, src_kek, key.data());
+    if (!key_seed.found() || (key_seed.key.size() < 0x10))
+        return byte_vector(src_kek, src_kek + 0x10);
+
+    aes128ContextCreate(&con, src_kek, false);
+    aes128DecryptBlock(&con, dest, key_seed.key.data());
+    return byte_vector(dest, dest + 0x10);
 }
\ No newline at end of file
@@ -16,20 +16,37 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vector>
 
 #include <switch/types.h>
+#include <switch/crypto/aes.h>
 
 #include <stdio.h>
 
 typedef std::vector<u8> byte_vector;
 
+// non-owning run of bytes, stands in for std::span<const u8> while the build is C++17
+struct byte_span {
+    byte_span() {}
+    byte_span(const u8 *data, size_t size) : data(data), size(size) {}
+    byte_span(const byte_vector &v) : data(v.data()), size(v.size()) {}
+
+    const u8 *begin() const { return data; }
+    const u8 *end() const { return data + size; }
+
+    const u8 *data = nullptr;
+    size_t size = 0;
+};
+
 class Key {
 public:
-    Key(std::string name, u64 xx_hash, byte_vector hash, u8 length, byte_vector key);
+    Key(std::string name, u64 xx_hash, u16 byte_sum, byte_vector hash, u8 length, byte_vector key);
     // init with hash only
     Key(std::string name, u64 xx_hash, byte_vector hash, u8 length);
+    // init with hash and byte sum for KeyScanner
+    Key(std::string name, u64 xx_hash, u16 byte_sum, byte_vector hash, u8 length);
     // init with key only
     Key(std::string name, u8 length, byte_vector key);
     // temp key, no name stored
@@ -49,22 +66,36 @@ public:
 
     // return CTR-decrypted data
     byte_vector aes_decrypt_ctr(const byte_vector &data, byte_vector iv);
+    // CTR-decrypt size bytes of src into dest without allocating
+    void aes_decrypt_ctr(const u8 *src, u8 *dest, size_t size, const u8 *iv);
     // return ECB-decrypted data
     byte_vector aes_decrypt_ecb(const byte_vector &data);
+    // ECB-decrypt size bytes of src into dest using cached round keys, size is a multiple of 0x10
+    void aes_decrypt_ecb(const u8 *src, u8 *dest, size_t size);
     // return CMAC of data
     byte_vector cmac(byte_vector data);
     // find key in buffer by hash, optionally specify start offset
-    void find_key(const byte_vector &buffer, size_t start = 0);
+    void find_key(byte_span buffer, size_t start = 0);
     // get key encryption key
     byte_vector generate_kek(Key &master_key, const Key &kek_seed, const Key &key_seed);
 
     byte_vector key;
     std::string name;
     u64 xx_hash;
+    // sum of first 0x10 key bytes, prefilter used by KeyScanner
+    u16 byte_sum;
     byte_vector hash;
     u8 length;
     bool is_found = false;
 
 private:
-    static size_t saved_key_count;
+    // decryption round keys for key, expanded again only when key changes
+    const Aes128Context &get_aes_context();
+
+    Aes128Context aes_context;
+    u8 aes_context_key[0x10];
+    bool aes_context_valid = false;
+
+    // consoles of a fleet can save their keyfiles at the same time on the host
+    static std::atomic<size_t> saved_key_count;
 };
\ No newline at end of file
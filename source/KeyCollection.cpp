@@ -17,45 +17,57 @@
 #include "KeyCollection.hpp"
 
 #include "Common.hpp"
-#include "Stopwatch.hpp"
+#include "CoreThread.hpp"
+#include "FileExtents.hpp"
+#include "KeyDerivation.hpp"
+#include "KeySearch.hpp"
+#include "OffsetCache.hpp"
+#include "Profiler.hpp"
+#include "Progress.hpp"
+#include "Rsa2048.hpp"
+#include "TicketBlockCache.hpp"
+#include "TicketDecryptor.hpp"
+#include "TitlekeyMap.hpp"
 
 #include <algorithm>
-#include <chrono>
+#include <atomic>
 #include <filesystem>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 
 #include <stdio.h>
+#include <string.h>
 
 #include <switch.h>
 
+#include "fatfs/diskio.h"
 #include "fatfs/ff.h"
 
 extern "C" {
     #include "nx/es.h"
 }
 
-#define TITLEKEY_BUFFER_SIZE 0x40000
-
-// hash of empty string
-const u8 KeyCollection::null_hash[0x20] = {
-        0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
-        0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55};
-
 FsStorage storage;
-
-// function timer
-template<typename Duration = std::chrono::microseconds, typename FT, typename ... Args>
-typename Duration::rep profile(FT&& fun, Args&&... args) {
-    const auto beg = std::chrono::high_resolution_clock::now();
-    std::invoke(fun, std::forward<Args>(args)...);
-    const auto end = std::chrono::high_resolution_clock::now();
-    return std::chrono::duration_cast<Duration>(end - beg).count();
+// SYSTEM image read by fatfs instead of storage in offline mode
+FILE *storage_image = NULL;
+// storage, the fatfs volume and the sector cache are shared by consoles of a fleet run side by side
+static std::mutex storage_mutex;
+
+// close SYSTEM storage or its image
+static void close_storage() {
+    if (storage_image != NULL) {
+        fclose(storage_image);
+        storage_image = NULL;
+    } else {
+        fsStorageClose(&storage);
+    }
 }
 
-KeyCollection::KeyCollection() {
+KeyCollection::KeyCollection(const std::string &dump_path) :
+    dump_path(dump_path)
+{
     // init all key hashes
     u8 index = 0;
     char keynum[] = "00";
@@ -134,50 +146,50 @@ KeyCollection::KeyCollection() {
 
     //=====================================Hashes=====================================//
     // from FS
-    header_kek_source = {"header_kek_source", 0x9fd1b07be05b8f4d, {
+    header_kek_source = {"header_kek_source", 0x9fd1b07be05b8f4d, 0x712, {
         0x18, 0x88, 0xca, 0xed, 0x55, 0x51, 0xb3, 0xed, 0xe0, 0x14, 0x99, 0xe8, 0x7c, 0xe0, 0xd8, 0x68,
         0x27, 0xf8, 0x08, 0x20, 0xef, 0xb2, 0x75, 0x92, 0x10, 0x55, 0xaa, 0x4e, 0x2a, 0xbd, 0xff, 0xc2}, 0x10};
-    header_key_source = {"header_key_source", 0x3e7228ec5873427b, {
+    header_key_source = {"header_key_source", 0x62662e1b561dc59a, 0x91b, { // xxhash of first 0x10 bytes
         0x8f, 0x78, 0x3e, 0x46, 0x85, 0x2d, 0xf6, 0xbe, 0x0b, 0xa4, 0xe1, 0x92, 0x73, 0xc4, 0xad, 0xba,
         0xee, 0x16, 0x38, 0x00, 0x43, 0xe1, 0xb8, 0xc4, 0x18, 0xc4, 0x08, 0x9a, 0x8b, 0xd6, 0x4a, 0xa6}, 0x20};
-    key_area_key_application_source = {"key_area_key_application_source", 0x0b14ccce20dbb59b, {
+    key_area_key_application_source = {"key_area_key_application_source", 0x0b14ccce20dbb59b, 0x5d7, {
         0x04, 0xad, 0x66, 0x14, 0x3c, 0x72, 0x6b, 0x2a, 0x13, 0x9f, 0xb6, 0xb2, 0x11, 0x28, 0xb4, 0x6f,
         0x56, 0xc5, 0x53, 0xb2, 0xb3, 0x88, 0x71, 0x10, 0x30, 0x42, 0x98, 0xd8, 0xd0, 0x09, 0x2d, 0x9e}, 0x10};
-    key_area_key_ocean_source = {"key_area_key_ocean_source", 0x055b26945075ff88, {
+    key_area_key_ocean_source = {"key_area_key_ocean_source", 0x055b26945075ff88, 0x790, {
         0xfd, 0x43, 0x40, 0x00, 0xc8, 0xff, 0x2b, 0x26, 0xf8, 0xe9, 0xa9, 0xd2, 0xd2, 0xc1, 0x2f, 0x6b,
         0xe5, 0x77, 0x3c, 0xbb, 0x9d, 0xc8, 0x63, 0x00, 0xe1, 0xbd, 0x99, 0xf8, 0xea, 0x33, 0xa4, 0x17}, 0x10};
-    key_area_key_system_source = {"key_area_key_system_source", 0xb2c28e84e1796251, {
+    key_area_key_system_source = {"key_area_key_system_source", 0xb2c28e84e1796251, 0x869, {
         0x1f, 0x17, 0xb1, 0xfd, 0x51, 0xad, 0x1c, 0x23, 0x79, 0xb5, 0x8f, 0x15, 0x2c, 0xa4, 0x91, 0x2e,
         0xc2, 0x10, 0x64, 0x41, 0xe5, 0x17, 0x22, 0xf3, 0x87, 0x00, 0xd5, 0x93, 0x7a, 0x11, 0x62, 0xf7}, 0x10};
-    save_mac_kek_source = {"save_mac_kek_source", 0x1e15ac1f6f21a26a, {
+    save_mac_kek_source = {"save_mac_kek_source", 0x1e15ac1f6f21a26a, 0x714, {
         0x3D, 0xCB, 0xA1, 0x00, 0xAD, 0x4D, 0xF1, 0x54, 0x7F, 0xE3, 0xC4, 0x79, 0x5C, 0x4B, 0x22, 0x8A,
         0xA9, 0x80, 0x38, 0xF0, 0x7A, 0x36, 0xF1, 0xBC, 0x14, 0x8E, 0xEA, 0xF3, 0xDC, 0xD7, 0x50, 0xF4}, 0x10};
-    save_mac_key_source = {"save_mac_key_source", 0x68b9ed0d367e6dc4, {
+    save_mac_key_source = {"save_mac_key_source", 0x68b9ed0d367e6dc4, 0x819, {
         0xB4, 0x7B, 0x60, 0x0B, 0x1A, 0xD3, 0x14, 0xF9, 0x41, 0x14, 0x7D, 0x8B, 0x39, 0x1D, 0x4B, 0x19,
         0x87, 0xCC, 0x8C, 0x88, 0x4A, 0xC8, 0x9F, 0xFC, 0x91, 0xCA, 0xE2, 0x21, 0xC5, 0x24, 0x51, 0xF7}, 0x10};
-    sd_card_kek_source = {"sd_card_kek_source", 0xc408d710a3b821eb, {
+    sd_card_kek_source = {"sd_card_kek_source", 0xc408d710a3b821eb, 0x72a, {
         0x6B, 0x2E, 0xD8, 0x77, 0xC2, 0xC5, 0x23, 0x34, 0xAC, 0x51, 0xE5, 0x9A, 0xBF, 0xA7, 0xEC, 0x45,
         0x7F, 0x4A, 0x7D, 0x01, 0xE4, 0x62, 0x91, 0xE9, 0xF2, 0xEA, 0xA4, 0x5F, 0x01, 0x1D, 0x24, 0xB7}, 0x10};
-    sd_card_nca_key_source = {"sd_card_nca_key_source", 0xb026106d9699fec0, { // xxhash of first 0x10 bytes
+    sd_card_nca_key_source = {"sd_card_nca_key_source", 0xb026106d9699fec0, 0x6f2, { // xxhash of first 0x10 bytes
         0x2E, 0x75, 0x1C, 0xEC, 0xF7, 0xD9, 0x3A, 0x2B, 0x95, 0x7B, 0xD5, 0xFF, 0xCB, 0x08, 0x2F, 0xD0,
         0x38, 0xCC, 0x28, 0x53, 0x21, 0x9D, 0xD3, 0x09, 0x2C, 0x6D, 0xAB, 0x98, 0x38, 0xF5, 0xA7, 0xCC}, 0x20};
-    sd_card_save_key_source = {"sd_card_save_key_source", 0x9697ba2fec3d3ed1, { // xxhash of first 0x10 bytes
+    sd_card_save_key_source = {"sd_card_save_key_source", 0x9697ba2fec3d3ed1, 0x75f, { // xxhash of first 0x10 bytes
         0xD4, 0x82, 0x74, 0x35, 0x63, 0xD3, 0xEA, 0x5D, 0xCD, 0xC3, 0xB7, 0x4E, 0x97, 0xC9, 0xAC, 0x8A,
         0x34, 0x21, 0x64, 0xFA, 0x04, 0x1A, 0x1D, 0xC8, 0x0F, 0x17, 0xF6, 0xD3, 0x1E, 0x4B, 0xC0, 0x1C}, 0x20};
 
     // from ES
-    eticket_rsa_kek_source = {"eticket_rsa_kek_source", 0x76d15de09d439bdc, {
+    eticket_rsa_kek_source = {"eticket_rsa_kek_source", 0x76d15de09d439bdc, 0x83d, {
         0xB7, 0x1D, 0xB2, 0x71, 0xDC, 0x33, 0x8D, 0xF3, 0x80, 0xAA, 0x2C, 0x43, 0x35, 0xEF, 0x88, 0x73,
         0xB1, 0xAF, 0xD4, 0x08, 0xE8, 0x0B, 0x35, 0x82, 0xD8, 0x71, 0x9F, 0xC8, 0x1C, 0x5E, 0x51, 0x1C}, 0x10};
-    eticket_rsa_kekek_source = {"eticket_rsa_kekek_source", 0x97436d4ff39703da, {
+    eticket_rsa_kekek_source = {"eticket_rsa_kekek_source", 0x97436d4ff39703da, 0x6df, {
         0xE8, 0x96, 0x5A, 0x18, 0x7D, 0x30, 0xE5, 0x78, 0x69, 0xF5, 0x62, 0xD0, 0x43, 0x83, 0xC9, 0x96,
         0xDE, 0x48, 0x7B, 0xBA, 0x57, 0x61, 0x36, 0x3D, 0x2D, 0x4D, 0x32, 0x39, 0x18, 0x66, 0xA8, 0x5C}, 0x10};
 
     // from SSL
-    ssl_rsa_kek_source_x = {"ssl_rsa_kek_source_x", 0xa7084dadd5d9da93, {
+    ssl_rsa_kek_source_x = {"ssl_rsa_kek_source_x", 0xa7084dadd5d9da93, 0x7d2, {
         0x69, 0xA0, 0x8E, 0x62, 0xE0, 0xAE, 0x50, 0x7B, 0xB5, 0xDA, 0x0E, 0x65, 0x17, 0x9A, 0xE3, 0xBE,
         0x05, 0x1F, 0xED, 0x3C, 0x49, 0x94, 0x1D, 0xF4, 0xEF, 0x29, 0x56, 0xD3, 0x6D, 0x30, 0x11, 0x0C}, 0x10};
-    ssl_rsa_kek_source_y = {"ssl_rsa_kek_source_y", 0xbafd95c9f258dc4a, {
+    ssl_rsa_kek_source_y = {"ssl_rsa_kek_source_y", 0xbafd95c9f258dc4a, 0x7b6, {
         0x1C, 0x86, 0xF3, 0x63, 0x26, 0x54, 0x17, 0xD4, 0x99, 0x22, 0x9E, 0xB1, 0xC4, 0xAD, 0xC7, 0x47,
         0x9B, 0x2A, 0x15, 0xF9, 0x31, 0x26, 0x1F, 0x31, 0xEE, 0x67, 0x76, 0xAE, 0xB4, 0xC7, 0x65, 0x42}, 0x10};
 
@@ -218,12 +230,24 @@ KeyCollection::KeyCollection() {
     };
 };
 
+std::vector<Key *> KeyCollection::get_memory_search_keys() {
+    std::vector<Key *> keys = fs_rodata_keys;
+    keys.push_back(&header_key_source);
+    keys.insert(keys.end(), ssl_keys.begin(), ssl_keys.end());
+    keys.insert(keys.end(), es_keys.begin(), es_keys.end());
+    return keys;
+}
+
 void KeyCollection::get_keys() {
-    Stopwatch total_time;
-    total_time.start();
+    Profiler::Zone total_time("get_keys");
 
-    int64_t profiler_time = profile(Common::get_tegra_keys, sbk, tsec, tsec_root_key);
-    if ((sbk.found() && tsec.found()) || tsec_root_key.found()) {
+    offline = !dump_path.empty();
+    std::string keyfile_str = offline ? dump_path + "/prod.keys" : "/switch/prod.keys";
+    const char *keyfile_path = keyfile_str.c_str();
+
+    int64_t profiler_time = Profiler::profile("get_tegra_keys", Common::get_tegra_keys, sbk, tsec, tsec_root_key, offline ? dump_path.c_str() : "/backup");
+    bool tegra_keys_found = (sbk.found() && tsec.found()) || tsec_root_key.found();
+    if (tegra_keys_found) {
         Common::draw_text_with_time(0x10, 0x60, GREEN, "Get Tegra keys...", profiler_time);
     } else {
         Common::draw_text(0x010, 0x60, RED, "Get Tegra keys...");
@@ -232,22 +256,42 @@ void KeyCollection::get_keys() {
         Common::draw_text(0x2a0, 0x80, RED, "Dump TSEC and Fuses with Hekate.");
     }
 
-    profiler_time = profile(&KeyCollection::get_memory_keys, *this);
-    Common::draw_text_with_time(0x10, 0x080, GREEN, "Get keys from memory...", profiler_time);
+    // tegra key warning already fills the spot of progress and results
+    if (tegra_keys_found)
+        Common::begin_progress(0x080);
+    profiler_time = Profiler::profile("get_memory_keys", &KeyCollection::get_memory_keys, *this);
+    Common::end_progress();
+    // keys in chunks that couldn't be read are missed, so the step is only partly done
+    u32 memory_color = (memory_chunks_failed > 0) ? YELLOW : GREEN;
+    Common::draw_text_with_time(0x10, 0x080, memory_color, "Get keys from memory...", profiler_time);
+    char bytes_str[96];
+    if (memory_chunks_failed > 0)
+        snprintf(bytes_str, sizeof(bytes_str), "Read %lu of %lu KiB, %lu chunks failed", memory_bytes_read / 0x400, memory_bytes_total / 0x400, memory_chunks_failed);
+    else
+        snprintf(bytes_str, sizeof(bytes_str), "Read %lu of %lu KiB", memory_bytes_read / 0x400, memory_bytes_total / 0x400);
+    if (tegra_keys_found)
+        Common::draw_text(0x2a0, 0x080, (memory_chunks_failed > 0) ? RED : CYAN, bytes_str);
 
-    profiler_time = profile(&KeyCollection::get_master_keys, *this);
+    profiler_time = Profiler::profile("get_master_keys", &KeyCollection::get_master_keys, *this);
     Common::draw_text_with_time(0x10, 0x0a0, GREEN, "Get master keys...", profiler_time);
 
-    profiler_time = profile(&KeyCollection::derive_keys, *this);
+    profiler_time = Profiler::profile("derive_keys", &KeyCollection::derive_keys, *this);
     Common::draw_text_with_time(0x10, 0x0c0, GREEN, "Derive remaining keys...", profiler_time);
+    if (offline) {
+        Common::draw_text(0x2a0, 0x0c0, YELLOW, "Offline: BIS keys skipped");
+    } else if (sd_seed.found()) {
+        char seed_str[48];
+        snprintf(seed_str, sizeof(seed_str), "SD seed found in %lu storage reads", sd_seed_storage_reads);
+        Common::draw_text(0x2a0, 0x0c0, CYAN, seed_str);
+    }
 
-    // avoid crash on CFWs that don't use /switch folder
-    if (!std::filesystem::exists("/switch"))
+    // avoid crash on CFWs that don't use /switch folder, offline the keyfile goes in the dump
+    if (!offline && !std::filesystem::exists("/switch"))
         std::filesystem::create_directory("/switch");
-    // since Lockpick_RCM can dump newer keys, check for existing keyfile
+    // since Lockpick_RCM can dump newer keys, check for existing keyfile, a recorded console can bring one along
     bool Lockpick_RCM_file_found = false;
-    if (std::filesystem::exists("/switch/prod.keys")) {
-        FILE *key_file = fopen("/switch/prod.keys", "r");
+    if (std::filesystem::exists(keyfile_path)) {
+        FILE *key_file = fopen(keyfile_path, "r");
         char line[0x200];
         while (fgets(line, sizeof(line), key_file)) {
             if (strncmp("master_key_07", line, 13) == 0) {
@@ -259,35 +303,108 @@ void KeyCollection::get_keys() {
         }
         fclose(key_file);
     }
+    // the count is shared by every console of a fleet
+    size_t saved_keys_before = Key::get_saved_key_count();
     if (!Lockpick_RCM_file_found) {
-        profiler_time = profile(&KeyCollection::save_keys, *this);
+        profiler_time = Profiler::profile("save_keys", &KeyCollection::save_keys, *this, keyfile_path);
         Common::draw_text_with_time(0x10, 0x0e0, GREEN, "Saving keys to keyfile...", profiler_time);
     } else {
         Common::draw_text(0x10, 0x0e0, YELLOW, "Saving keys to keyfile...");
         Common::draw_text(0x190, 0x0e0, YELLOW, "Newer keyfile found. Skipped overwriting keys");
     }
 
-    total_time.stop();
     Common::draw_line(0x8, 0xf0, 0x280, GREEN);
     Common::draw_text_with_time(0x10, 0x110, GREEN, "Total time elapsed:", total_time.get_elapsed());
 
-    char keys_str[32];
+    char keys_str[64];
     if (!Lockpick_RCM_file_found) {
-        sprintf(keys_str, "Total keys found: %lu", Key::get_saved_key_count());
+        snprintf(keys_str, sizeof(keys_str), "Total keys found: %lu", Key::get_saved_key_count() - saved_keys_before);
         Common::draw_text(0x2a0, 0x110, CYAN, keys_str);
-        Common::draw_text(0x80, 0x140, YELLOW, "Keys saved to \"/switch/prod.keys\"!");
+        // keyfile_str is under the dump directory when offline, so its length isn't bounded
+        std::string saved_str = "Keys saved to \"" + keyfile_str + "\"!";
+        Common::draw_text(0x80, 0x140, YELLOW, saved_str.c_str());
     }
 
     Common::draw_text(0x10, 0x170, CYAN, "Dumping titlekeys...");
     Common::update_display();
-    profiler_time = profile(&KeyCollection::get_titlekeys, *this);
+    Common::begin_progress(0x170);
+    profiler_time = Profiler::profile("get_titlekeys", &KeyCollection::get_titlekeys, *this);
+    Common::end_progress();
     Common::draw_text_with_time(0x10, 0x170, GREEN, "Dumping titlekeys...", profiler_time);
-    sprintf(keys_str, "Titlekeys found: %lu", titlekeys_dumped);
+    snprintf(keys_str, sizeof(keys_str), "Titlekeys found: %lu (%.0f personalized/s)", titlekeys_dumped, personalized_tickets_per_second);
     Common::draw_text(0x2a0, 0x170, CYAN, keys_str);
-    if (titlekeys_dumped > 0)
-        Common::draw_text(0x80, 0x1a0, YELLOW, "Titlekeys saved to \"/switch/title.keys\"!");
-    else
+    if (titlekeys_dumped > 0) {
+        std::string titlekeys_saved_str = "Titlekeys saved to \"" + get_titlekey_path() + "\"!";
+        Common::draw_text(0x80, 0x1a0, YELLOW, titlekeys_saved_str.c_str());
+    } else {
         Common::draw_text(0x80, 0x1a0, GREEN, "No titlekeys found. Either you've never played or installed a game or dump failed.");
+    }
+    if (exp_mod_spl_ms > 0) {
+        char exp_mod_str[0x60];
+        snprintf(exp_mod_str, sizeof(exp_mod_str), "RSA-2048 modexp: spl %.1f ms, local %.1f ms x%d threads (using %s)",
+            exp_mod_spl_ms, exp_mod_local_ms, TICKET_EXP_MOD_THREADS, local_exp_mod ? "local" : "spl");
+        Common::draw_text(0x80, 0x1d0, CYAN, exp_mod_str);
+    }
+}
+
+bool KeyCollection::get_fleet_keys(const std::string &fleet_path) {
+    if (!std::filesystem::is_directory(fleet_path))
+        return false;
+    std::vector<std::string> consoles;
+    for (auto &entry : std::filesystem::directory_iterator(fleet_path)) {
+        if (entry.is_directory())
+            consoles.push_back(entry.path().string());
+    }
+    if (consoles.empty())
+        return false;
+    std::sort(consoles.begin(), consoles.end());
+
+    // consoles run one after another since the screen follows one at a time,
+    // each one still searches and derives across cores
+    std::unique_ptr<KeyCollection> previous;
+    char console_str[0x100];
+    for (size_t i = 0; i < consoles.size(); i++) {
+        std::unique_ptr<KeyCollection> keys(new KeyCollection(consoles[i]));
+        if (previous)
+            keys->reuse_memory_keys(*previous);
+
+        Common::reset_steps();
+        // left of the Lockpick_RCM note
+        Common::draw_set_rect(0x10, 0x28, 0x1c0, 0x1c, 0);
+        snprintf(console_str, sizeof(console_str), "Console %lu of %lu: %.24s", i + 1, consoles.size(),
+            std::filesystem::path(consoles[i]).filename().c_str());
+        Common::draw_text(0x10, 0x040, YELLOW, console_str);
+        keys->get_keys();
+        previous = std::move(keys);
+    }
+
+    return true;
+}
+
+bool KeyCollection::get_fleet_keys(const std::vector<std::string> &consoles, size_t threads) {
+    if (consoles.empty())
+        return false;
+
+    // memory keys of the first console are taken over by every other one, so it runs on its own
+    KeyCollection first(consoles[0]);
+    first.get_keys();
+
+    std::atomic<size_t> next_console(1);
+    auto run_consoles = [&] {
+        for (size_t i = next_console++; i < consoles.size(); i = next_console++) {
+            KeyCollection keys(consoles[i]);
+            keys.reuse_memory_keys(first);
+            keys.get_keys();
+        }
+    };
+    // this thread is one of the workers, so consoles still get done if none of the others start
+    std::vector<std::unique_ptr<CoreThread>> workers;
+    for (size_t i = 1; i < std::min(threads, consoles.size() - 1); i++)
+        workers.emplace_back(new CoreThread(i, run_consoles));
+    run_consoles();
+    for (auto &w : workers)
+        w->join();
+    return true;
 }
 
 void KeyCollection::get_master_keys() {
@@ -304,9 +421,22 @@ void KeyCollection::get_master_keys() {
 
     if (!keyblob_mac_key.empty()) {
         KeyLocation Keyblobs;
-        Keyblobs.get_keyblobs();
+        // Keyblobs may borrow the image so it stays open until they're used
+        std::unique_ptr<FileMemory> boot0;
+        if (offline) {
+            boot0.reset(new FileMemory((dump_path + "/BOOT0.bin").c_str()));
+            Keyblobs.get_keyblobs(*boot0);
+        } else {
+            Keyblobs.get_keyblobs();
+        }
         u8 index = 0;
-        for (byte_vector::const_iterator It = Keyblobs.data.begin(); It != Keyblobs.data.end(); It += 0x200) {
+        byte_span keyblobs = Keyblobs.get_data();
+        // keyblobs that couldn't be read can't be checked, so nothing is derived from them
+        if (keyblobs.size < 0x200 * keyblob_mac_key.size()) {
+            keyblob_key.clear();
+            keyblob_mac_key.clear();
+        }
+        for (const u8 *It = keyblobs.begin(); (It != keyblobs.end()) && (index < keyblob_mac_key.size()); It += 0x200) {
             sprintf(keynum, "%02x", index);
             encrypted_keyblob.push_back(Key {"encrypted_keyblob_" + std::string(keynum), 0xb0, byte_vector(It, It + 0xb0)});
             byte_vector keyblob_mac(keyblob_mac_key[index].cmac(byte_vector(encrypted_keyblob.back().key.begin() + 0x10, encrypted_keyblob.back().key.end())));
@@ -322,7 +452,7 @@ void KeyCollection::get_master_keys() {
         }
     }
 
-    for (u8 i = 0; i < keyblob_key.size(); i++) {
+    for (u8 i = 0; i < std::min(keyblob_key.size(), encrypted_keyblob.size()); i++) {
         sprintf(keynum, "%02x", i);
         keyblob.push_back(Key {"keyblob_" + std::string(keynum), 0x90,
                 keyblob_key[i].aes_decrypt_ctr(
@@ -357,160 +487,257 @@ void KeyCollection::get_master_keys() {
     }
 }
 
-void KeyCollection::get_memory_keys() {
-    KeyLocation
-        ESRodata,
-        FSRodata,
-        FSData,
-        SSLRodata;
+std::string KeyCollection::get_titlekey_path() const {
+    return offline ? dump_path + "/title.keys" : "/switch/title.keys";
+}
 
-    FSRodata.get_from_memory(FS_TID, SEG_RODATA);
-    FSData.get_from_memory(FS_TID, SEG_DATA);
+bool KeyCollection::open_storage() {
+    if (offline) {
+        storage_image = fopen((dump_path + "/SYSTEM.bin").c_str(), "rb");
+        return storage_image != NULL;
+    }
+    fsOpenBisStorage(&storage, FsBisPartitionId_System);
+    return true;
+}
 
-    FSRodata.find_keys(fs_rodata_keys);
+std::unique_ptr<MemorySource> KeyCollection::open_memory(u64 tid, u8 seg_mask, const char *dump_name) {
+    if (offline)
+        return std::unique_ptr<MemorySource>(new FileMemory((dump_path + "/" + dump_name).c_str()));
+    return std::unique_ptr<MemorySource>(new ProcessMemory(tid, seg_mask));
+}
 
-    size_t i = 0;
-    /*for ( ; i < FSData.data.size(); i++) {
-        // speeds things up but i'm not 100% sure this is always here
-        if (*reinterpret_cast<u128 *>(FSData.data.data() + i) == 0x10001)
-            break;
-    }*/
-    header_key_source.find_key(FSData.data, i);
+void KeyCollection::reuse_memory_keys(const KeyCollection &other) {
+    for (auto keys : {&KeyCollection::fs_rodata_keys, &KeyCollection::ssl_keys, &KeyCollection::es_keys}) {
+        for (size_t i = 0; i < (this->*keys).size(); i++) {
+            if ((other.*keys)[i]->found())
+                *(this->*keys)[i] = *(other.*keys)[i];
+        }
+    }
+    if (other.header_key_source.found())
+        header_key_source = other.header_key_source;
+}
 
-    SSLRodata.get_from_memory(SSL_TID, SEG_RODATA);
-    // using find_keys on these is actually slower
-    for (auto k : ssl_keys)
-        k->find_key(SSLRodata.data);
+void KeyCollection::get_memory_keys() {
+    OffsetCache cache;
+    cache.load();
+
+    // titles stay attached until these go out of scope, and a title only takes one debugger
+    // so FS .rodata and .data are searched together
+    std::unique_ptr<MemorySource>
+        FSMemory = open_memory(FS_TID, SEG_RODATA | SEG_DATA, "FS.bin"),
+        SSLRodata = open_memory(SSL_TID, SEG_RODATA, "SSL.bin"),
+        ESRodata;
+
+    std::vector<Key *> fs_keys(fs_rodata_keys);
+    fs_keys.push_back(&header_key_source);
+
+    // keys at their cached offsets are skipped, the rest are scanned across cores a chunk at a time
+    KeySearch search;
+    cache.find_keys(*FSMemory, fs_keys);
+    search.add(*FSMemory, fs_keys);
+    cache.find_keys(*SSLRodata, ssl_keys);
+    search.add(*SSLRodata, ssl_keys);
+
+    // firmware 1.0.0 doesn't have the ES keys, offline the dump is simply missing
+    if (offline || kernelAbove200()) {
+        ESRodata = open_memory(ES_TID, SEG_RODATA, "ES.bin");
+        cache.find_keys(*ESRodata, es_keys);
+        search.add(*ESRodata, es_keys);
+    }
 
-    // firmware 1.0.0 doesn't have the ES keys
-    if (!kernelAbove200())
-        return;
-    ESRodata.get_from_memory(ES_TID, SEG_RODATA);
-    for (auto k : es_keys)
-        k->find_key(ESRodata.data);
+    search.run();
+    memory_bytes_read = search.get_bytes_read();
+    memory_bytes_total = search.get_bytes_total();
+    memory_chunks_failed = search.get_chunks_failed();
+
+    for (auto &m : search.get_matches())
+        cache.set_offset(*m.source, *m.key, m.offset);
+
+    // FS stays suspended while debugged, and saving the cache goes through FS to the sd card
+    FSMemory.reset();
+    SSLRodata.reset();
+    ESRodata.reset();
+    cache.save();
 }
 
 void KeyCollection::derive_keys() {
-    if (header_kek_source.found() && header_key_source.found()) {
-        u8 tempheaderkek[0x10], tempheaderkey[0x20];
-        splCryptoInitialize();
-        splCryptoGenerateAesKek(header_kek_source.key.data(), 0, 0, tempheaderkek);
-        splCryptoGenerateAesKey(tempheaderkek, header_key_source.key.data() + 0x00, tempheaderkey + 0x00);
-        splCryptoGenerateAesKey(tempheaderkek, header_key_source.key.data() + 0x10, tempheaderkey + 0x10);
-        header_key = {"header_key", 0x20, byte_vector(tempheaderkey, tempheaderkey + 0x20)};
-        splCryptoExit();
-    }
+    KeyDerivation graph;
+
+    graph.add({&header_kek_source, &header_key_source}, [this] { derive_header_key(); });
+    // bis keys are unique to the console running this, not the recorded one
+    if (!offline)
+        graph.add({&bis_kek_source, &bis_key_source_00, &bis_key_source_01, &bis_key_source_02}, [this] { derive_bis_keys(); });
+    graph.add({}, [this] { get_sd_seed(); });
+
+    size_t rsa_kek_generation_sources = graph.add({&aes_kek_generation_source, &aes_kek_seed_01, &aes_kek_seed_03}, [this] {
+        for (u8 i = 0; i < aes_kek_generation_source.key.size(); i++) {
+            rsa_oaep_kek_generation_source.key.push_back(aes_kek_generation_source.key[i] ^ aes_kek_seed_03.key[i]);
+            rsa_private_kek_generation_source.key.push_back(aes_kek_generation_source.key[i] ^ aes_kek_seed_01.key[i]);
+        }
+        rsa_oaep_kek_generation_source.set_found();
+        rsa_private_kek_generation_source.set_found();
+    });
 
-    u64 key_generation = 0;
-    SetSysFirmwareVersion ver;
+    if (!keyblob_key.empty()) {
+        size_t device_key_step = graph.add({&keyblob_key[0]}, [this] {
+            device_key = Key {"device_key", 0x10, keyblob_key[0].aes_decrypt_ecb(per_console_key_source.key)};
+        });
+        graph.add({&device_key, &save_mac_kek_source, &save_mac_key_source}, [this] {
+            Key kek = {save_mac_kek_source.generate_kek(device_key, aes_kek_generation_source, Key {}), 0x10};
+            save_mac_key = Key {"save_mac_key", 0x10, kek.aes_decrypt_ecb(save_mac_key_source.key)};
+        }, {device_key_step});
+    }
 
-    setsysInitialize();
-    setsysGetFirmwareVersion(&ver);
-    setsysExit();
+    // every master key fills its own slot so families can be derived side by side
+    key_area_key_application.resize(master_key.size());
+    key_area_key_ocean.resize(master_key.size());
+    key_area_key_system.resize(master_key.size());
+    package2_key.resize(master_key.size());
+    titlekek.resize(master_key.size());
+    std::vector<size_t> rsa_kek_after = {rsa_kek_generation_sources};
+    for (size_t i = 0; i < master_key.size(); i++) {
+        size_t family = graph.add({&master_key[i]}, [this, i] { derive_master_key_family(i); });
+        // master_key_00's cached round keys can't be used from two threads at once
+        if (i == 0)
+            rsa_kek_after.push_back(family);
+    }
 
-    Result rc = 0;
-    if (ver.major >= 5) {
-        rc = splGetConfig(SplConfigItem_NewKeyGeneration, &key_generation);
+    if (!master_key.empty()) {
+        graph.add({&eticket_rsa_kek_source, &eticket_rsa_kekek_source, &master_key[0]}, [this] {
+            eticket_rsa_kek = Key {"eticket_rsa_kek", 0x10,
+                eticket_rsa_kekek_source.generate_kek(master_key[0], rsa_oaep_kek_generation_source, eticket_rsa_kek_source)};
+        }, rsa_kek_after);
+        graph.add({&ssl_rsa_kek_source_x, &ssl_rsa_kek_source_y, &master_key[0]}, [this] {
+            ssl_rsa_kek = Key {"ssl_rsa_kek", 0x10,
+                ssl_rsa_kek_source_x.generate_kek(master_key[0], rsa_private_kek_generation_source, ssl_rsa_kek_source_y)};
+        }, rsa_kek_after);
     }
 
-    if (R_SUCCEEDED(rc) && bis_key_source_00.found() && bis_key_source_01.found() && bis_key_source_02.found()) {
-        u8 tempbiskek[0x10], tempbiskey[0x20];
+    // opening and closing a service isn't safe to race, so steps only use sessions opened here
+    splCryptoInitialize();
+    if (!offline) {
         splFsInitialize();
-        splFsGenerateSpecificAesKey(bis_key_source_00.key.data() + 0x00, key_generation, 0, tempbiskey + 0x00);
-        splFsGenerateSpecificAesKey(bis_key_source_00.key.data() + 0x10, key_generation, 0, tempbiskey + 0x10);
-        bis_key.push_back(Key {"bis_key_00", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
+        setsysInitialize();
+    }
+    graph.run();
+    if (!offline) {
+        setsysExit();
         splFsExit();
-
-        splCryptoInitialize();
-        splCryptoGenerateAesKek(bis_kek_source.key.data(), key_generation, 1, tempbiskek);
-        splCryptoGenerateAesKey(tempbiskek, bis_key_source_01.key.data() + 0x00, tempbiskey + 0x00);
-        splCryptoGenerateAesKey(tempbiskek, bis_key_source_01.key.data() + 0x10, tempbiskey + 0x10);
-        bis_key.push_back(Key {"bis_key_01", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
-        splCryptoGenerateAesKey(tempbiskek, bis_key_source_02.key.data() + 0x00, tempbiskey + 0x00);
-        splCryptoGenerateAesKey(tempbiskek, bis_key_source_02.key.data() + 0x10, tempbiskey + 0x10);
-        bis_key.push_back(Key {"bis_key_02", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
-        bis_key.push_back(Key {"bis_key_03", 0x20, bis_key[2].key});
-        splCryptoExit();
     }
+    splCryptoExit();
+}
 
-    for (u8 i = 0; i < aes_kek_generation_source.key.size(); i++) {
-        rsa_oaep_kek_generation_source.key.push_back(aes_kek_generation_source.key[i] ^ aes_kek_seed_03.key[i]);
-        rsa_private_kek_generation_source.key.push_back(aes_kek_generation_source.key[i] ^ aes_kek_seed_01.key[i]);
-    }
-    rsa_oaep_kek_generation_source.set_found();
-    rsa_private_kek_generation_source.set_found();
+void KeyCollection::derive_header_key() {
+    u8 tempheaderkek[0x10], tempheaderkey[0x20];
+    Result rc = splCryptoGenerateAesKek(header_kek_source.key.data(), 0, 0, tempheaderkek);
+    if (R_SUCCEEDED(rc))
+        rc = splCryptoGenerateAesKey(tempheaderkek, header_key_source.key.data() + 0x00, tempheaderkey + 0x00);
+    if (R_SUCCEEDED(rc))
+        rc = splCryptoGenerateAesKey(tempheaderkek, header_key_source.key.data() + 0x10, tempheaderkey + 0x10);
+    Profiler::count(Profiler::IPC_CALLS, 3);
+    // spl is missing on the host, and a failed call leaves nothing worth saving
+    if (R_FAILED(rc))
+        return;
+    header_key = {"header_key", 0x20, byte_vector(tempheaderkey, tempheaderkey + 0x20)};
+}
 
-    if (!keyblob_key.empty())
-        device_key = Key {"device_key", 0x10, keyblob_key[0].aes_decrypt_ecb(per_console_key_source.key)};
+void KeyCollection::derive_bis_keys() {
+    u64 key_generation = 0;
+    SetSysFirmwareVersion ver;
 
-    if (device_key.found() && save_mac_kek_source.found() && save_mac_key_source.found()) {
-        Key kek = {save_mac_kek_source.generate_kek(device_key, aes_kek_generation_source, Key {}), 0x10};
-        save_mac_key = Key {"save_mac_key", 0x10, kek.aes_decrypt_ecb(save_mac_key_source.key)};
+    setsysGetFirmwareVersion(&ver);
+    Profiler::count(Profiler::IPC_CALLS);
+
+    Result rc = 0;
+    if (ver.major >= 5) {
+        rc = splGetConfig(SplConfigItem_NewKeyGeneration, &key_generation);
+        Profiler::count(Profiler::IPC_CALLS);
     }
+    if (R_FAILED(rc))
+        return;
+
+    u8 tempbiskek[0x10], tempbiskey[0x20];
+    splFsGenerateSpecificAesKey(bis_key_source_00.key.data() + 0x00, key_generation, 0, tempbiskey + 0x00);
+    splFsGenerateSpecificAesKey(bis_key_source_00.key.data() + 0x10, key_generation, 0, tempbiskey + 0x10);
+    Profiler::count(Profiler::IPC_CALLS, 2);
+    bis_key.push_back(Key {"bis_key_00", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
+
+    splCryptoGenerateAesKek(bis_kek_source.key.data(), key_generation, 1, tempbiskek);
+    splCryptoGenerateAesKey(tempbiskek, bis_key_source_01.key.data() + 0x00, tempbiskey + 0x00);
+    splCryptoGenerateAesKey(tempbiskek, bis_key_source_01.key.data() + 0x10, tempbiskey + 0x10);
+    bis_key.push_back(Key {"bis_key_01", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
+    splCryptoGenerateAesKey(tempbiskek, bis_key_source_02.key.data() + 0x00, tempbiskey + 0x00);
+    splCryptoGenerateAesKey(tempbiskek, bis_key_source_02.key.data() + 0x10, tempbiskey + 0x10);
+    Profiler::count(Profiler::IPC_CALLS, 5);
+    bis_key.push_back(Key {"bis_key_02", 0x20, byte_vector(tempbiskey, tempbiskey + 0x20)});
+    bis_key.push_back(Key {"bis_key_03", 0x20, bis_key[2].key});
+}
 
+void KeyCollection::derive_master_key_family(size_t i) {
     char keynum[] = "00";
-    for (u8 i = 0; i < master_key.size(); i++) {
-        if (!master_key[i].found())
-            continue;
-        sprintf(keynum, "%02x", i);
-        key_area_key_application.push_back(Key {"key_area_key_application_" + std::string(keynum), 0x10,
-                key_area_key_application_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)});
-        key_area_key_ocean.push_back(Key {"key_area_key_ocean_" + std::string(keynum), 0x10,
-                key_area_key_ocean_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)});
-        key_area_key_system.push_back(Key {"key_area_key_system_" + std::string(keynum), 0x10,
-                key_area_key_system_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)});
-        package2_key.push_back(Key {"package2_key_" + std::string(keynum), 0x10, master_key[i].aes_decrypt_ecb(package2_key_source.key)});
-        titlekek.push_back(Key {"titlekek_" + std::string(keynum), 0x10, master_key[i].aes_decrypt_ecb(titlekek_source.key)});
-    }
-
-    if (eticket_rsa_kek_source.found() && eticket_rsa_kekek_source.found() && !master_key.empty())
-        eticket_rsa_kek = Key {"eticket_rsa_kek", 0x10,
-            eticket_rsa_kekek_source.generate_kek(master_key[0], rsa_oaep_kek_generation_source, eticket_rsa_kek_source)};
-    if (ssl_rsa_kek_source_x.found() && ssl_rsa_kek_source_y.found() && !master_key.empty())
-        ssl_rsa_kek = Key {"ssl_rsa_kek", 0x10,
-            ssl_rsa_kek_source_x.generate_kek(master_key[0], rsa_private_kek_generation_source, ssl_rsa_kek_source_y)};
-
-    char seed_vector[0x10], seed[0x10], buffer[0x10];
-    u32 bytes_read, file_pos = 0;
+    sprintf(keynum, "%02lx", i);
+    if (key_area_key_application_source.found())
+        key_area_key_application[i] = Key {"key_area_key_application_" + std::string(keynum), 0x10,
+                key_area_key_application_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)};
+    if (key_area_key_ocean_source.found())
+        key_area_key_ocean[i] = Key {"key_area_key_ocean_" + std::string(keynum), 0x10,
+                key_area_key_ocean_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)};
+    if (key_area_key_system_source.found())
+        key_area_key_system[i] = Key {"key_area_key_system_" + std::string(keynum), 0x10,
+                key_area_key_system_source.generate_kek(master_key[i], aes_kek_generation_source, aes_key_generation_source)};
+    package2_key[i] = Key {"package2_key_" + std::string(keynum), 0x10, master_key[i].aes_decrypt_ecb(package2_key_source.key)};
+    titlekek[i] = Key {"titlekek_" + std::string(keynum), 0x10, master_key[i].aes_decrypt_ecb(titlekek_source.key)};
+}
+
+void KeyCollection::get_sd_seed() {
+    u8 seed_vector[0x10];
 
     // dump sd seed
-    if (!kernelAbove200())
+    if (!offline && !kernelAbove200())
         return;
-    FILE *sd_private = fopen("/Nintendo/Contents/private", "rb");
+    FILE *sd_private = fopen(offline ? (dump_path + "/private").c_str() : "/Nintendo/Contents/private", "rb");
     if (!sd_private) return;
     fread(seed_vector, 0x10, 1, sd_private);
     fclose(sd_private);
 
     FATFS fs;
-    FRESULT fr;
     FIL save_file;
 
-    fsOpenBisStorage(&storage, FsBisPartitionId_System);
+    std::lock_guard<std::mutex> storage_lock(storage_mutex);
+    if (!open_storage())
+        return;
     if (f_mount(&fs, "", 1) ||
         f_chdir("/save") ||
         f_open(&save_file, "8000000000000043", FA_READ | FA_OPEN_EXISTING))
     {
-        fsStorageClose(&storage);
+        close_storage();
         return;
     }
 
-    for (;;) {
-        fr = f_read(&save_file, buffer, 0x10, &bytes_read);
-        if (fr || (bytes_read == 0)) break;
-        if (std::equal(seed_vector, seed_vector + 0x10, buffer)) {
-            f_read(&save_file, seed, 0x10, &bytes_read);
-            sd_seed = Key {"sd_seed", 0x10, byte_vector(seed, seed + 0x10)};
+    DWORD hits, misses, readaheads, reads_before, reads_after;
+    disk_cache_get_stats(&hits, &misses, &readaheads, &reads_before);
+
+    // seed vector and seed sit together at the start of one of the save's 0x4000 byte blocks
+    FileExtents extents;
+    extents.map(save_file);
+    u8 probe[0x20];
+    for (u64 offset = 0; extents.read(probe, offset, sizeof(probe)); offset += 0x4000) {
+        if (std::equal(seed_vector, seed_vector + 0x10, probe)) {
+            sd_seed = Key {"sd_seed", 0x10, byte_vector(probe + 0x10, probe + 0x20)};
             break;
         }
-        file_pos += 0x4000;
-        if (f_lseek(&save_file, file_pos)) break;
     }
+
+    disk_cache_get_stats(&hits, &misses, &readaheads, &reads_after);
+    sd_seed_storage_reads = reads_after - reads_before;
+    if (!offline)
+        Profiler::count(Profiler::IPC_CALLS, sd_seed_storage_reads);
     f_close(&save_file);
-    fsStorageClose(&storage);
+    close_storage();
 }
 
-void KeyCollection::save_keys() {
-    FILE *key_file = fopen("/switch/prod.keys", "w");
+void KeyCollection::save_keys(const char *path) {
+    FILE *key_file = fopen(path, "w");
     if (!key_file) return;
 
     aes_kek_generation_source.save_key(key_file);
@@ -582,20 +809,32 @@ void KeyCollection::save_keys() {
     fclose(key_file);
 }
 
-void KeyCollection::get_titlekeys() {
-    if (!kernelAbove200() || !eticket_rsa_kek.found())
-        return;
+// append rights ids of every ticket in save to rights_ids, returns how many distinct ones it holds
+static size_t list_rights_ids(TicketBlockCache &ticket_blocks, const char *save_name, size_t save, std::vector<RightsId> &rights_ids) {
+    FIL save_file;
+    if (f_open(&save_file, save_name, FA_READ | FA_OPEN_EXISTING))
+        return 0;
+
+    std::vector<RightsId> save_rights_ids;
+    ticket_blocks.read_tickets(save_file, save, [&](const u8 *record) {
+        save_rights_ids.emplace_back();
+        std::copy(record + 0x2a0, record + 0x2b0, save_rights_ids.back().c);
+        return false;
+    });
+    f_close(&save_file);
 
-    u32 common_count, personalized_count, bytes_read, ids_written;
+    // copies of a ticket count once, like es lists them
+    auto less = [](const RightsId &a, const RightsId &b) { return memcmp(a.c, b.c, sizeof(a.c)) < 0; };
+    auto equal = [](const RightsId &a, const RightsId &b) { return memcmp(a.c, b.c, sizeof(a.c)) == 0; };
+    std::sort(save_rights_ids.begin(), save_rights_ids.end(), less);
+    save_rights_ids.erase(std::unique(save_rights_ids.begin(), save_rights_ids.end(), equal), save_rights_ids.end());
+    rights_ids.insert(rights_ids.end(), save_rights_ids.begin(), save_rights_ids.end());
+    return save_rights_ids.size();
+}
 
-    esInitialize();
-    esCountCommonTicket(&common_count);
-    esCountPersonalizedTicket(&personalized_count);
-    RightsId common_rights_ids[common_count], personalized_rights_ids[personalized_count];
-    esListCommonTicket(&ids_written, common_rights_ids, sizeof(common_rights_ids));
-    esListPersonalizedTicket(&ids_written, personalized_rights_ids, sizeof(personalized_rights_ids));
-    esExit();
-    if (common_count + personalized_count == 0)
+void KeyCollection::get_titlekeys() {
+    // es, setcal and spl are needed to list and decrypt tickets, a recorded console brings its tickets and eticket key along
+    if ((!offline && !kernelAbove200()) || !eticket_rsa_kek.found())
         return;
 
     /*
@@ -603,27 +842,42 @@ void KeyCollection::get_titlekeys() {
         since we are crawling the whole save file, we might accidentally find previously deleted tickets
         this would be fine, except we have to match the exact list so we don't stop too early
     */
-    char titlekey_block[0x100], buffer[TITLEKEY_BUFFER_SIZE], rights_id_string[0x21], titlekey_string[0x21];
-    std::unordered_set<std::string> rights_ids;
-    for (size_t i = 0; i < common_count; i++) {
-        for (size_t j = 0; j < 0x10; j++) {
-            sprintf(&rights_id_string[j*2], "%02x", common_rights_ids[i].c[j]);
-        }
-        rights_ids.insert(rights_id_string);
-    }
-    for (size_t i = 0; i < personalized_count; i++) {
-        for (size_t j = 0; j < 0x10; j++) {
-            sprintf(&rights_id_string[j*2], "%02x", personalized_rights_ids[i].c[j]);
-        }
-        rights_ids.insert(rights_id_string);
+    std::vector<RightsId> rights_ids;
+    size_t common_count = 0, personalized_count = 0;
+    if (!offline) {
+        u32 es_common_count, es_personalized_count, ids_written;
+
+        esInitialize();
+        esCountCommonTicket(&es_common_count);
+        esCountPersonalizedTicket(&es_personalized_count);
+        RightsId common_rights_ids[es_common_count], personalized_rights_ids[es_personalized_count];
+        esListCommonTicket(&ids_written, common_rights_ids, sizeof(common_rights_ids));
+        esListPersonalizedTicket(&ids_written, personalized_rights_ids, sizeof(personalized_rights_ids));
+        Profiler::count(Profiler::IPC_CALLS, 4);
+        esExit();
+        if (es_common_count + es_personalized_count == 0)
+            return;
+
+        rights_ids.assign(common_rights_ids, common_rights_ids + es_common_count);
+        rights_ids.insert(rights_ids.end(), personalized_rights_ids, personalized_rights_ids + es_personalized_count);
+        common_count = es_common_count;
+        personalized_count = es_personalized_count;
     }
 
-    // get extended eticket RSA key from PRODINFO
+    // get extended eticket RSA key from PRODINFO, or the copy recorded with the console
     SetCalRsa2048DeviceKey eticket_data = {};
 
-    setcalInitialize();
-    setcalGetEticketDeviceKey(&eticket_data);
-    setcalExit();
+    if (offline) {
+        FILE *eticket_file = fopen((dump_path + "/" + ETICKET_DEVICE_KEY_DUMP).c_str(), "rb");
+        if (!eticket_file) return;
+        size_t blobs_read = fread(eticket_data.key, sizeof(eticket_data.key), 1, eticket_file);
+        fclose(eticket_file);
+        if (blobs_read != 1) return;
+    } else {
+        setcalInitialize();
+        setcalGetEticketDeviceKey(&eticket_data);
+        setcalExit();
+    }
 
     byte_vector dec_keypair = eticket_rsa_kek.aes_decrypt_ctr(
         byte_vector(eticket_data.key + 0x10, eticket_data.key + 0x240),
@@ -640,129 +894,96 @@ void KeyCollection::get_titlekeys() {
         return;
 
     FATFS fs;
-    FRESULT fr;
     FIL save_file;
-    // map of all found rights ids and corresponding titlekeys
-    std::unordered_map<std::string, std::string> titlekeys;
 
-    fsOpenBisStorage(&storage, FsBisPartitionId_System);
-    if (f_mount(&fs, "", 1) || f_chdir("/save")) return;
-    if (f_open(&save_file, "80000000000000e1", FA_READ | FA_OPEN_EXISTING)) return;
-    while ((common_count != 0) && (titlekeys_dumped < common_count)) {
-        fr = f_read(&save_file, buffer, TITLEKEY_BUFFER_SIZE, &bytes_read);
-        if (fr || (bytes_read == 0)) break;
-        for (size_t i = 0; i < bytes_read; i += 0x4000) {
-            for (size_t j = i; j < i + 0x4000; j += 0x400) {
-                if (*reinterpret_cast<u32 *>(&buffer[j]) == 0x10004) {
-                    for (size_t k = 0; k < 0x10; k++)
-                        sprintf(&rights_id_string[k*2], "%02x", buffer[j + 0x2a0 + k]);
-
-                    // skip if rights id not reported by es
-                    if (rights_ids.find(rights_id_string) == rights_ids.end())
-                        continue;
-                    // skip if rights id already in map
-                    if (titlekeys.find(rights_id_string) != titlekeys.end())
-                        continue;
-
-                    for (size_t k = 0; k < 0x10; k++)
-                        sprintf(&titlekey_string[k*2], "%02x", buffer[j + 0x180 + k]);
-                    titlekeys[rights_id_string] = titlekey_string;
-                    titlekeys_dumped++;
-                } else {
-                    break;
-                }
-            }
-        }
+    DWORD hits, misses, readaheads, reads_before, reads_after;
+    std::lock_guard<std::mutex> storage_lock(storage_mutex);
+    disk_cache_get_stats(&hits, &misses, &readaheads, &reads_before);
+
+    if (!open_storage())
+        return;
+    if (f_mount(&fs, "", 1) || f_chdir("/save")) {
+        close_storage();
+        return;
+    }
+    TicketBlockCache ticket_blocks;
+    // blocks are remembered for this console's saves only, a recording is read whole
+    if (!offline)
+        ticket_blocks.load();
+
+    // without es every ticket in the saves is wanted, the listing read leaves their blocks in ticket_blocks
+    if (offline) {
+        common_count = list_rights_ids(ticket_blocks, "80000000000000e1", 0, rights_ids);
+        personalized_count = list_rights_ids(ticket_blocks, "80000000000000e2", 1, rights_ids);
+    }
+    TitlekeyMap titlekeys(rights_ids.data(), rights_ids.size());
+
+    if (f_open(&save_file, "80000000000000e1", FA_READ | FA_OPEN_EXISTING)) {
+        close_storage();
+        return;
+    }
+    if (common_count != 0) {
+        ticket_blocks.read_tickets(save_file, 0, [&](const u8 *record) {
+            // skip if rights id not reported by es or already found
+            size_t slot = titlekeys.find(record + 0x2a0);
+            if ((slot != TITLEKEY_NOT_FOUND) && titlekeys.set(slot, record + 0x180))
+                Progress::tickets_processed++;
+            return titlekeys.get_count() >= common_count;
+        });
     }
     f_close(&save_file);
 
-    u8 M[0x100];
-
-    if (f_open(&save_file, "80000000000000e2", FA_READ | FA_OPEN_EXISTING)) return;
-    while ((personalized_count != 0) && (titlekeys_dumped < common_count + personalized_count)) {
-        fr = f_read(&save_file, buffer, TITLEKEY_BUFFER_SIZE, &bytes_read);
-        if (fr || (bytes_read == 0)) break;
-        for (size_t i = 0; i < bytes_read; i += 0x4000) {
-            for (size_t j = i; j < i + 0x4000; j += 0x400) {
-                if (*reinterpret_cast<u32 *>(&buffer[j]) == 0x10004) {
-                    for (size_t k = 0; k < 0x10; k++)
-                        sprintf(&rights_id_string[k*2], "%02x", buffer[j + 0x2a0 + k]);
-
-                    // skip if rights id not reported by es
-                    if (rights_ids.find(rights_id_string) == rights_ids.end())
-                        continue;
-                    // skip if rights id already in map
-                    if (titlekeys.find(rights_id_string) != titlekeys.end())
-                        continue;
-
-                    std::copy(buffer + j + 0x180, buffer + j + 0x280, titlekey_block);
-
-                    splUserExpMod(titlekey_block, N, D, 0x100, M);
-
-                    // decrypts the titlekey from personalized ticket
-                    u8 salt[0x20], db[0xdf];
-                    mgf1(M + 0x21, 0xdf, salt, 0x20);
-                    for (size_t k = 0; k < 0x20; k++)
-                        salt[k] ^= M[k + 1];
-
-                    mgf1(salt, 0x20, db, 0xdf);
-                    for (size_t k = 0; k < 0xdf; k++)
-                        db[k] ^= M[k + 0x21];
-
-                    // verify it starts with hash of null string
-                    if (!std::equal(db, db + 0x20, null_hash))
-                        continue;
-
-                    for (size_t k = 0; k < 0x10; k++)
-                        sprintf(&titlekey_string[k*2], "%02x", db[k + 0xcf]);
-                    titlekeys[rights_id_string] = titlekey_string;
-                    titlekeys_dumped++;
-                } else {
-                    break;
-                }
-            }
-        }
+    if (f_open(&save_file, "80000000000000e2", FA_READ | FA_OPEN_EXISTING)) {
+        close_storage();
+        return;
     }
+    TicketDecryptor decryptor(D, N, local_exp_mod, titlekeys);
+    if (personalized_count != 0)
+        decryptor.decrypt_save(ticket_blocks, save_file, 1);
+    personalized_tickets_per_second = decryptor.get_tickets_per_second();
+
+    titlekeys_dumped = titlekeys.get_count();
     f_close(&save_file);
-    fsStorageClose(&storage);
+    close_storage();
+    disk_cache_get_stats(&hits, &misses, &readaheads, &reads_after);
+    if (!offline) {
+        Profiler::count(Profiler::IPC_CALLS, reads_after - reads_before);
+        ticket_blocks.save();
+    }
 
-    if (titlekeys.empty())
+    if (titlekeys_dumped == 0)
         return;
 
-    FILE *titlekey_file = fopen("/switch/title.keys", "wb");
+    FILE *titlekey_file = fopen(get_titlekey_path().c_str(), "wb");
     if (!titlekey_file) return;
-    for (auto k : titlekeys)
-        fprintf(titlekey_file, "%s = %s\n", k.first.c_str(), k.second.c_str());
+    titlekeys.save(titlekey_file);
     fclose(titlekey_file);
 }
 
-void KeyCollection::mgf1(const u8 *data, size_t data_length, u8 *mask, size_t mask_length) {
-    u8 data_counter[data_length + 4] = {};
-    std::copy(data, data + data_length, data_counter);
-    sha256CalculateHash(mask, data_counter, data_length + 4);
-    for (u32 i = 1; i < (mask_length / 0x20) + 1; i++) {
-        for (size_t j = 0; j < 4; j++)
-            data_counter[data_length + 3 - j] = (i >> (8 * j)) & 0xff;
-        if (i * 0x20 <= mask_length)
-            sha256CalculateHash(mask + (i * 0x20), data_counter, data_length + 4);
-            else {
-            u8 temp_mask[0x20];
-            sha256CalculateHash(temp_mask, data_counter, data_length + 4);
-            std::copy(temp_mask, temp_mask + mask_length - (i * 0x20), mask + (i * 0x20));
-        }
-    }
-}
-
 bool KeyCollection::test_key_pair(const void *E, const void *D, const void *N) {
-    u8 X[0x100] = {0}, Y[0x100] = {0}, Z[0x100] = {0};
+    u8 X[0x100] = {0}, Y[0x100] = {0}, Z[0x100] = {0}, local_Y[0x100] = {0};
 
     // 0xCAFEBABE
     X[0xfc] = 0xca; X[0xfd] = 0xfe; X[0xfe] = 0xba; X[0xff] = 0xbe;
-    splUserExpMod(X, N, D, 0x100, Y);
+    {
+        Profiler::Zone exp_mod_time("splUserExpMod");
+        splUserExpMod(X, N, D, 0x100, Y);
+        exp_mod_spl_ms = exp_mod_time.get_elapsed() / 1000.0f;
+    }
     splUserExpMod(Y, N, E, 4, Z);
+    Profiler::count(Profiler::IPC_CALLS, 2);
     for (size_t i = 0; i < 0x100; i++)
         if (X[i] != Z[i])
             return false;
 
+    // benchmark the local backend on the same private key op and only trust it if it agrees with spl
+    Rsa2048 rsa(static_cast<const u8 *>(N));
+    {
+        Profiler::Zone exp_mod_time("Rsa2048::exp_mod");
+        rsa.exp_mod(X, static_cast<const u8 *>(D), 0x100, local_Y);
+        exp_mod_local_ms = exp_mod_time.get_elapsed() / 1000.0f;
+    }
+    local_exp_mod = std::equal(Y, Y + 0x100, local_Y) && (exp_mod_local_ms < exp_mod_spl_ms * TICKET_EXP_MOD_THREADS);
+
     return true;
 }
\ No newline at end of file
@@ -18,29 +18,62 @@
 
 #include "Key.hpp"
 #include "KeyLocation.hpp"
+#include "MemorySource.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <switch/types.h>
 
+// recorded console: FS.bin, SSL.bin and ES.bin segments, BOOT0.bin, SYSTEM.bin, tegra key dumps, sd "private"
+// and the eticket device key blob of PRODINFO
+#define OFFLINE_DUMP_PATH "/switch/lockpick/dump"
+// the 0x240 bytes setcalGetEticketDeviceKey gives, in a recorded console
+#define ETICKET_DEVICE_KEY_DUMP "eticket_device_key.bin"
+// one recorded console per subdirectory, each laid out like OFFLINE_DUMP_PATH
+#define FLEET_DUMP_PATH "/switch/lockpick/fleet"
+
 class KeyCollection {
 public:
-    KeyCollection();
+    // dump_path holds a recorded console to use instead of this one, empty for this console
+    KeyCollection(const std::string &dump_path = "");
 
     // get KeyLocations and find keys in them
     void get_keys();
+    // get keys of every console under fleet_path into their own directories, false if there are none
+    static bool get_fleet_keys(const std::string &fleet_path);
+    // same for the consoles listed, up to threads of them at once, nothing is drawn so it's meant for the host build
+    static bool get_fleet_keys(const std::vector<std::string> &consoles, size_t threads);
+    // keys located by scanning FS, SSL and ES memory, host tests check their KeyScanner prefilter values
+    std::vector<Key *> get_memory_search_keys();
 
 private:
     // utility functions called by get_keys
+    // segments of running title, or their dump in offline mode
+    std::unique_ptr<MemorySource> open_memory(u64 tid, u8 seg_mask, const char *dump_name);
+    // SYSTEM storage for fatfs, or its image in offline mode, closed with close_storage
+    bool open_storage();
+    // take keys other found in memory, they're the same on every console so its scans don't need repeating
+    void reuse_memory_keys(const KeyCollection &other);
+    // title.keys of this console, next to prod.keys of a recorded one
+    std::string get_titlekey_path() const;
     void get_master_keys();
     void get_memory_keys();
     // derive calculated/encrypted keys
     void derive_keys();
+    // derivation steps scheduled by derive_keys, spl and set:sys must already be initialized
+    void derive_header_key();
+    void derive_bis_keys();
+    // keys derived from master_key[i]
+    void derive_master_key_family(size_t i);
+    // find sd seed in system save
+    void get_sd_seed();
     // save keys to key file
-    void save_keys();
+    void save_keys(const char *path);
 
     // get titlekeys from es syssaves
     void get_titlekeys();
-    // mask generation function used by get_titlekeys
-    void mgf1(const u8 *data, size_t data_length, u8 *mask, size_t mask_length);
     // key pair tester for get_titlekeys
     bool test_key_pair(const void *E, const void *D, const void *N);
 
@@ -115,8 +148,20 @@ private:
     std::vector<Key *>
         es_keys, fs_rodata_keys, ssl_keys;
 
-    // hash of empty string used to verify titlekeys for personalized tickets
-    static const u8 null_hash[0x20];
-
     size_t titlekeys_dumped = 0;
+    // throughput of personalized ticket decryption
+    float personalized_tickets_per_second = 0;
+    // single private key modexp timed by test_key_pair for each backend
+    float exp_mod_spl_ms = 0, exp_mod_local_ms = 0;
+    // ticket modexp runs on Rsa2048 across cores when that outpaces spl
+    bool local_exp_mod = false;
+    // keys come from dump_path, console-bound derivations are skipped
+    bool offline = false;
+    std::string dump_path;
+    // process memory scanned by get_memory_keys out of the segments' total size
+    size_t memory_bytes_read = 0, memory_bytes_total = 0;
+    // chunks of process memory that couldn't be read even after retrying
+    size_t memory_chunks_failed = 0;
+    // reads of SYSTEM storage get_sd_seed needed
+    size_t sd_seed_storage_reads = 0;
 };
\ No newline at end of file
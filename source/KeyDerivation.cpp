@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "KeyDerivation.hpp"
+
+#include "CoreThread.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <memory>
+
+size_t KeyDerivation::add(const std::vector<const Key *> &inputs, std::function<void()> derive, const std::vector<size_t> &after) {
+    steps.push_back({inputs, derive, {}, after.size()});
+    for (auto i : after)
+        steps[i].dependents.push_back(steps.size() - 1);
+    return steps.size() - 1;
+}
+
+void KeyDerivation::run() {
+    for (size_t i = 0; i < steps.size(); i++) {
+        if (steps[i].steps_left == 0)
+            ready.push_back(i);
+    }
+
+    std::vector<std::unique_ptr<CoreThread>> workers;
+    for (size_t i = 1; i < std::min<size_t>(DERIVE_THREADS, steps.size()); i++)
+        workers.emplace_back(new CoreThread(i, [this] { work(); }));
+    work();
+    for (auto &t : workers)
+        t->join();
+
+    steps.clear();
+    steps_done = 0;
+}
+
+void KeyDerivation::work() {
+    Profiler::Zone zone("KeyDerivation::work");
+    std::unique_lock<std::mutex> lock(step_mutex);
+    for (;;) {
+        step_ready.wait(lock, [this] { return !ready.empty() || (steps_done == steps.size()); });
+        if (ready.empty())
+            return;
+
+        Step &step = steps[ready.back()];
+        ready.pop_back();
+
+        // inputs come from steps this one waited on, so they are final by now
+        lock.unlock();
+        if (std::all_of(step.inputs.begin(), step.inputs.end(), [](const Key *k) { return k->found(); }))
+            step.derive();
+        lock.lock();
+
+        steps_done++;
+        for (auto i : step.dependents) {
+            if (--steps[i].steps_left == 0)
+                ready.push_back(i);
+        }
+        step_ready.notify_all();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Key.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <switch/types.h>
+
+// threads deriving at once including the caller
+#define DERIVE_THREADS 3
+
+// derivation steps that each name the keys they need, independent steps run in parallel
+class KeyDerivation {
+public:
+    /*
+        add step deriving keys from inputs once the steps in after have run, returns its id
+        steps with any input not found are skipped along with what they would derive
+    */
+    size_t add(const std::vector<const Key *> &inputs, std::function<void()> derive, const std::vector<size_t> &after = {});
+    // run all reachable steps
+    void run();
+
+private:
+    struct Step {
+        std::vector<const Key *> inputs;
+        std::function<void()> derive;
+        // steps waiting on this one
+        std::vector<size_t> dependents;
+        size_t steps_left;
+    };
+
+    // thread body, takes ready steps until all have run
+    void work();
+
+    std::vector<Step> steps;
+    std::vector<size_t> ready;
+    size_t steps_done = 0;
+    std::mutex step_mutex;
+    std::condition_variable step_ready;
+};
\ No newline at end of file
@@ -17,8 +17,7 @@
 #pragma once
 
 #include "Key.hpp"
-
-#include <vector>
+#include "MemorySource.hpp"
 
 #include <switch/types.h>
 
@@ -41,17 +40,23 @@
 
 #define KEYBLOB_OFFSET 0x180000
 
-typedef std::vector<u8> byte_vector;
-
 class KeyLocation {
 public:
-    // get memory in requested segments from running title
-    void get_from_memory(u64 tid, u8 seg_mask);
+    KeyLocation() {}
+    KeyLocation(const KeyLocation &) = delete;
+    KeyLocation &operator=(const KeyLocation &) = delete;
+
     // get keyblobs from BOOT0
     void get_keyblobs();
-    // locate keys in data
-    void find_keys(std::vector<Key *> &keys);
-
+    // get keyblobs from BOOT0 image, borrowed without copying if it's in memory so boot0 must outlive this
+    void get_keyblobs(MemorySource &boot0);
     // data found by get functions
+    byte_span get_data() const { return bytes; }
+
+private:
+    // copy of bytes read from a source that couldn't be viewed
+    void set_owned();
+
     byte_vector data;
+    byte_span bytes;
 };
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "KeyScanner.hpp"
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+
+#include <string.h>
+
+#include <switch.h>
+
+#if !defined(SCAN_NO_SIMD) && defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define SCAN_NEON
+#elif !defined(SCAN_NO_SIMD) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define SCAN_SSE2
+#endif
+
+#define XXH_PRIME1 11400714785074694791ULL
+#define XXH_PRIME2 14029467366897019727ULL
+#define XXH_PRIME3  1609587929392839161ULL
+#define XXH_PRIME4  9650029242287828579ULL
+#define XXH_PRIME5  2870177450012600261ULL
+
+static inline u64 rotate_left(u64 x, u8 bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+static inline u64 xxhash_round(u64 input) {
+    return rotate_left(input * XXH_PRIME2, 31) * XXH_PRIME1;
+}
+
+// same result as XXHash64::hash(window, SCAN_WINDOW, 0) without the streaming state
+static inline u64 xxhash_window(const u8 *window) {
+    u64 lane0, lane1;
+    memcpy(&lane0, window, 8);
+    memcpy(&lane1, window + 8, 8);
+
+    u64 result = XXH_PRIME5 + SCAN_WINDOW;
+    result = rotate_left(result ^ xxhash_round(lane0), 27) * XXH_PRIME1 + XXH_PRIME4;
+    result = rotate_left(result ^ xxhash_round(lane1), 27) * XXH_PRIME1 + XXH_PRIME4;
+
+    result ^= result >> 33;
+    result *= XXH_PRIME2;
+    result ^= result >> 29;
+    result *= XXH_PRIME3;
+    result ^= result >> 32;
+    return result;
+}
+
+KeyScanner::KeyScanner(const std::vector<Key *> &keys) {
+    size_t table_size = 8;
+    table_shift = 61;
+    while (table_size < keys.size() * 2) {
+        table_size <<= 1;
+        table_shift--;
+    }
+    table.resize(table_size, {0, nullptr, SCAN_NOT_FOUND, {}});
+
+    for (auto k : keys) {
+        if (k->found())
+            continue;
+        size_t i = k->xx_hash >> table_shift;
+        while (table[i].key != nullptr)
+            i = (i + 1) & (table.size() - 1);
+        table[i].xx_hash = k->xx_hash;
+        table[i].key = k;
+        keys_left++;
+    }
+    update_filter();
+}
+
+void KeyScanner::update_filter() {
+    std::fill(sum_filter, sum_filter + sizeof(sum_filter) / sizeof(u64), 0);
+    sums.clear();
+    for (auto &s : table) {
+        if ((s.key == nullptr) || (s.offset != SCAN_NOT_FOUND))
+            continue;
+        if (!sum_matches(s.key->byte_sum))
+            sums.insert(sums.end(), SCAN_BLOCK, s.key->byte_sum);
+        sum_filter[s.key->byte_sum / 64] |= 1ULL << (s.key->byte_sum % 64);
+    }
+}
+
+/*
+    window sums after the current one differ from it by the running total of
+    (byte entering window - byte leaving window), so one prefix sum over
+    SCAN_BLOCK such deltas yields SCAN_BLOCK window sums
+*/
+#if defined(SCAN_NEON)
+u32 KeyScanner::filter_blocks(const u8 *data, size_t size, size_t &offset, u16 &sum) const {
+    uint16x8_t zero = vdupq_n_u16(0);
+    uint16x8_t window_sums = vdupq_n_u16(sum);
+    u64 lanes = 0;
+
+    for ( ; offset + SCAN_BLOCK + SCAN_WINDOW <= size; offset += SCAN_BLOCK) {
+        const u8 *window = data + offset;
+        uint16x8_t delta = vsubl_u8(vld1_u8(window + SCAN_WINDOW), vld1_u8(window));
+        delta = vaddq_u16(delta, vextq_u16(zero, delta, 7));
+        delta = vaddq_u16(delta, vextq_u16(zero, delta, 6));
+        delta = vaddq_u16(delta, vextq_u16(zero, delta, 4));
+        window_sums = vaddq_u16(delta, vdupq_laneq_u16(window_sums, 7));
+
+        uint16x8_t match = zero;
+        for (size_t k = 0; k < sums.size(); k += SCAN_BLOCK)
+            match = vorrq_u16(match, vceqq_u16(window_sums, vld1q_u16(&sums[k])));
+        lanes = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(match)), 0);
+        if (lanes != 0)
+            break;
+    }
+    sum = vgetq_lane_u16(window_sums, 7);
+
+    u32 mask = 0;
+    for (u32 j = 0; j < SCAN_BLOCK; j++)
+        mask |= ((lanes >> (j * 8)) & 1) << j;
+    return mask;
+}
+#elif defined(SCAN_SSE2)
+u32 KeyScanner::filter_blocks(const u8 *data, size_t size, size_t &offset, u16 &sum) const {
+    __m128i zero = _mm_setzero_si128();
+    __m128i window_sums = _mm_set1_epi16(sum);
+    u32 mask = 0;
+
+    for ( ; offset + SCAN_BLOCK + SCAN_WINDOW <= size; offset += SCAN_BLOCK) {
+        const u8 *window = data + offset;
+        __m128i delta = _mm_sub_epi16(
+            _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(window + SCAN_WINDOW)), zero),
+            _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(window)), zero));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 2));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 4));
+        delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 8));
+        window_sums = _mm_add_epi16(delta, _mm_unpackhi_epi64(_mm_shufflehi_epi16(window_sums, 0xff), _mm_shufflehi_epi16(window_sums, 0xff)));
+
+        __m128i match = zero;
+        for (size_t k = 0; k < sums.size(); k += SCAN_BLOCK)
+            match = _mm_or_si128(match, _mm_cmpeq_epi16(window_sums, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&sums[k]))));
+        mask = _mm_movemask_epi8(_mm_packs_epi16(match, zero));
+        if (mask != 0)
+            break;
+    }
+    sum = _mm_extract_epi16(window_sums, 7);
+    return mask;
+}
+#else
+u32 KeyScanner::filter_blocks(const u8 *data, size_t size, size_t &offset, u16 &sum) const {
+    for ( ; offset + SCAN_BLOCK + SCAN_WINDOW <= size; offset += SCAN_BLOCK) {
+        const u8 *window = data + offset;
+        u32 mask = 0;
+        for (u32 j = 0; j < SCAN_BLOCK; j++) {
+            sum += window[SCAN_WINDOW + j] - window[j];
+            if (sum_matches(sum))
+                mask |= 1 << j;
+        }
+        if (mask != 0)
+            return mask;
+    }
+    return 0;
+}
+#endif
+
+size_t KeyScanner::probe(const u8 *window) const {
+    u64 hash = xxhash_window(window);
+    Profiler::count(Profiler::HASHES);
+    for (size_t i = hash >> table_shift; table[i].key != nullptr; i = (i + 1) & (table.size() - 1)) {
+        if ((table[i].xx_hash == hash) && (table[i].offset == SCAN_NOT_FOUND))
+            return i;
+    }
+    return SCAN_NOT_FOUND;
+}
+
+size_t KeyScanner::confirm(const u8 *data, size_t size, size_t offset) const {
+    size_t i = probe(data + offset);
+    if ((i == SCAN_NOT_FOUND) || (offset + table[i].key->length > size))
+        return SCAN_NOT_FOUND;
+
+    // double-check sha256 since xxhash64 isn't as collision-safe
+    u8 temp_hash[0x20];
+    sha256CalculateHash(temp_hash, data + offset, table[i].key->length);
+    Profiler::count(Profiler::SHA256_CONFIRMS);
+    if (!std::equal(table[i].key->hash.begin(), table[i].key->hash.end(), temp_hash))
+        return SCAN_NOT_FOUND;
+    return i;
+}
+
+size_t KeyScanner::next_match(const u8 *data, size_t size, size_t &offset) const {
+    size_t i = offset;
+    u16 sum = 0;
+    for (size_t j = 0; j < SCAN_WINDOW; j++)
+        sum += data[i + j];
+
+    size_t slot;
+    if (sum_matches(sum) && ((slot = confirm(data, size, i)) != SCAN_NOT_FOUND))
+        return slot;
+
+    // filter whole blocks of windows while they fit in the buffer
+    for (u32 mask; (mask = filter_blocks(data, size, i, sum)) != 0; i += SCAN_BLOCK) {
+        for ( ; mask != 0; mask &= mask - 1) {
+            offset = i + 1 + __builtin_ctz(mask);
+            if ((slot = confirm(data, size, offset)) != SCAN_NOT_FOUND)
+                return slot;
+        }
+    }
+
+    // roll the byte sum over the remaining windows one at a time
+    for ( ; i + SCAN_WINDOW < size; i++) {
+        sum += data[i + SCAN_WINDOW] - data[i];
+        if (sum_matches(sum) && ((slot = confirm(data, size, i + 1)) != SCAN_NOT_FOUND)) {
+            offset = i + 1;
+            return slot;
+        }
+    }
+
+    offset = size;
+    return SCAN_NOT_FOUND;
+}
+
+bool KeyScanner::scan(const u8 *data, size_t size, size_t base) {
+    size_t offset = 0;
+    while (!done() && (offset + SCAN_WINDOW <= size)) {
+        size_t i = next_match(data, size, offset);
+        if (i == SCAN_NOT_FOUND)
+            break;
+
+        Slot &s = table[i];
+        s.offset = base + offset;
+        s.match.assign(data + offset, data + offset + s.key->length);
+        keys_left--;
+        update_filter();
+        // keys never overlap so resume after this one
+        offset += s.key->length;
+    }
+
+    return done();
+}
+
+void KeyScanner::merge(const KeyScanner &other) {
+    // both tables have the same layout when built from the same keys
+    if (other.table.size() != table.size())
+        return;
+
+    for (size_t i = 0; i < table.size(); i++) {
+        const Slot &s = other.table[i];
+        if ((s.key != table[i].key) || (s.offset >= table[i].offset))
+            continue;
+        if (table[i].offset == SCAN_NOT_FOUND)
+            keys_left--;
+        table[i].offset = s.offset;
+        table[i].match = s.match;
+    }
+    update_filter();
+}
+
+void KeyScanner::store() {
+    for (auto &s : table) {
+        if ((s.key == nullptr) || (s.offset == SCAN_NOT_FOUND) || s.key->found())
+            continue;
+        s.key->key = s.match;
+        s.key->set_found();
+    }
+}
+
+std::vector<std::pair<Key *, size_t>> KeyScanner::get_matches() const {
+    std::vector<std::pair<Key *, size_t>> matches;
+    for (auto &s : table) {
+        if ((s.key != nullptr) && (s.offset != SCAN_NOT_FOUND))
+            matches.emplace_back(s.key, s.offset);
+    }
+    return matches;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Key.hpp"
+
+#include <utility>
+#include <vector>
+
+#include <switch/types.h>
+
+// keys are matched by their first 0x10 bytes
+#define SCAN_WINDOW 0x10
+// largest possible sum of SCAN_WINDOW bytes
+#define SCAN_MAX_SUM (SCAN_WINDOW * 0xff)
+// windows tested at once by the vector filter
+#define SCAN_BLOCK 8
+// offset of a key not found yet
+#define SCAN_NOT_FOUND SIZE_MAX
+
+class KeyScanner {
+public:
+    KeyScanner(const std::vector<Key *> &keys);
+
+    /*
+        find remaining keys of any length in one pass over buffer, returns true once all keys are found
+        base is the offset of buffer within the whole searched region
+    */
+    bool scan(const u8 *data, size_t size, size_t base = 0);
+    // take matches from scanner built with the same keys where they come before ours
+    void merge(const KeyScanner &other);
+    // copy matched bytes into their keys
+    void store();
+    // keys matched so far and their offsets
+    std::vector<std::pair<Key *, size_t>> get_matches() const;
+
+    bool done() const { return keys_left == 0; }
+    size_t get_keys_left() const { return keys_left; }
+
+private:
+    struct Slot {
+        u64 xx_hash;
+        Key *key;
+        size_t offset;
+        byte_vector match;
+    };
+
+    // rebuild byte sum filter from keys not yet found
+    void update_filter();
+    bool sum_matches(u16 sum) const { return sum_filter[sum / 64] & (1ULL << (sum % 64)); }
+    /*
+        test windows after the one at offset summing to sum, SCAN_BLOCK at a time
+        stops at the first block with windows passing the filter and returns their bitmask,
+        offset is left at that block and sum at its last window
+    */
+    u32 filter_blocks(const u8 *data, size_t size, size_t &offset, u16 &sum) const;
+    // slot of remaining key matching xxhash of window, SCAN_NOT_FOUND if none
+    size_t probe(const u8 *window) const;
+    // slot of remaining key whose xxhash and sha256 match window at offset, SCAN_NOT_FOUND if none
+    size_t confirm(const u8 *data, size_t size, size_t offset) const;
+    // slot of first window from offset holding a remaining key, offset is moved to it
+    size_t next_match(const u8 *data, size_t size, size_t &offset) const;
+
+    // one bit per possible window byte sum
+    u64 sum_filter[SCAN_MAX_SUM / 64 + 1];
+    // distinct byte sums of remaining keys for the vector filter, each repeated SCAN_BLOCK times
+    std::vector<u16> sums;
+    // open-addressed xxhash -> key table, size is a power of two
+    std::vector<Slot> table;
+    u8 table_shift;
+    size_t keys_left = 0;
+};
\ No newline at end of file
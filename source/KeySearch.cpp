@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "KeySearch.hpp"
+
+#include "CoreThread.hpp"
+#include "Profiler.hpp"
+#include "Progress.hpp"
+
+#include <algorithm>
+#include <memory>
+
+KeySearch::Search::Search(MemorySource &source, size_t overlap, const std::vector<Key *> &keys) :
+    source(&source),
+    size(source.size()),
+    overlap(overlap),
+    result(keys)
+{
+}
+
+void KeySearch::add(MemorySource &source, const std::vector<Key *> &keys) {
+    if (source.size() == 0)
+        return;
+
+    u8 max_length = SCAN_WINDOW;
+    for (auto k : keys)
+        max_length = std::max(max_length, k->length);
+    searches.emplace_back(source, max_length - 1, keys);
+
+    Search &s = searches.back();
+    bytes_total += s.size;
+    // keys may already be known from elsewhere
+    s.done = s.result.done();
+    if (s.done)
+        return;
+
+    size_t chunk_count = (s.size + SEARCH_CHUNK_SIZE - 1) / SEARCH_CHUNK_SIZE;
+    s.chunks.assign(chunk_count, s.result);
+    s.chunk_done.assign(chunk_count, false);
+    for (size_t i = 0; i < chunk_count; i++)
+        jobs.push_back({searches.size() - 1, i});
+}
+
+void KeySearch::run() {
+    next_job = 0;
+
+    // the caller works on its own core, helpers take the others
+    std::vector<std::unique_ptr<CoreThread>> workers;
+    for (size_t i = 1; i < std::min<size_t>(SEARCH_THREADS, jobs.size()); i++)
+        workers.emplace_back(new CoreThread(i, [this] { work(); }));
+    work();
+    for (auto &t : workers)
+        t->join();
+
+    for (auto &s : searches) {
+        s.result.store();
+        for (auto &m : s.result.get_matches())
+            matches.push_back({s.source, m.first, m.second});
+    }
+    searches.clear();
+    jobs.clear();
+}
+
+void KeySearch::work() {
+    Profiler::Zone zone("KeySearch::work");
+    // reused for every chunk of sources not already in memory
+    byte_vector buffer;
+
+    for (size_t j; (j = next_job++) < jobs.size(); ) {
+        Search &s = searches[jobs[j].search];
+        size_t chunk = jobs[j].chunk;
+        {
+            // every key was already found in earlier chunks
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            if (s.done || (chunk > s.last_chunk))
+                continue;
+        }
+
+        size_t start = chunk * SEARCH_CHUNK_SIZE;
+        size_t end = std::min(start + SEARCH_CHUNK_SIZE + s.overlap, s.size);
+        size_t bytes = 0;
+        const u8 *data = s.source->view();
+        if (data != nullptr) {
+            data += start;
+        } else {
+            buffer.resize(end - start);
+            std::lock_guard<std::mutex> lock(read_mutex);
+            // debug reads can fail transiently, a second failure gives up on the chunk
+            for (size_t attempt = 0; (attempt < SEARCH_READ_ATTEMPTS) && (data == nullptr); attempt++) {
+                if (s.source->read(buffer.data(), start, buffer.size()))
+                    data = buffer.data();
+            }
+        }
+
+        if (data != nullptr) {
+            s.chunks[chunk].scan(data, end - start, start);
+            bytes = end - start;
+            Profiler::count(Profiler::BYTES_READ, bytes);
+        }
+        finish_chunk(s, chunk, bytes);
+    }
+}
+
+void KeySearch::finish_chunk(Search &s, size_t chunk, size_t bytes) {
+    std::lock_guard<std::mutex> lock(merge_mutex);
+    s.chunk_done[chunk] = true;
+    bytes_read += bytes;
+    if (bytes == 0)
+        chunks_failed++;
+    Progress::bytes_scanned += bytes;
+    if (s.chunks[chunk].done())
+        s.last_chunk = std::min(s.last_chunk, chunk);
+
+    // merging strictly in chunk order keeps the first match of every key, same as one serial pass
+    while (!s.done && (s.next_merge < s.chunks.size()) && s.chunk_done[s.next_merge]) {
+        size_t keys_left = s.result.get_keys_left();
+        s.result.merge(s.chunks[s.next_merge++]);
+        Progress::keys_found += keys_left - s.result.get_keys_left();
+        s.done = s.result.done();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Key.hpp"
+#include "KeyScanner.hpp"
+#include "MemorySource.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <switch/types.h>
+
+// threads scanning at once including the caller, the last core belongs to the system
+#define SEARCH_THREADS 3
+// bytes of a source scanned by one job, also the most each thread holds in memory
+#define SEARCH_CHUNK_SIZE 0x40000
+// reads of a chunk before it is counted as failed
+#define SEARCH_READ_ATTEMPTS 2
+
+class KeySearch {
+public:
+    struct Match {
+        MemorySource *source;
+        Key *key;
+        size_t offset;
+    };
+
+    // queue search for keys in source, which must outlive run()
+    void add(MemorySource &source, const std::vector<Key *> &keys);
+    // scan all queued locations in chunks across threads and store found keys
+    void run();
+
+    // bytes scanned so far, chunks skipped once their search was complete aren't read
+    size_t get_bytes_read() const { return bytes_read; }
+    // bytes in all sources added so far
+    size_t get_bytes_total() const { return bytes_total; }
+    // chunks that couldn't be read, keys in them are missed or found at a later copy
+    size_t get_chunks_failed() const { return chunks_failed; }
+    // keys found by run() and where
+    const std::vector<Match> &get_matches() const { return matches; }
+
+private:
+    struct Search {
+        Search(MemorySource &source, size_t overlap, const std::vector<Key *> &keys);
+
+        MemorySource *source;
+        size_t size;
+        // chunks also cover this many bytes of the next one so keys spanning both are found
+        size_t overlap;
+        // chunk results merged in order
+        KeyScanner result;
+        std::vector<KeyScanner> chunks;
+        std::vector<bool> chunk_done;
+        size_t next_merge = 0;
+        // first chunk that found every key on its own, later chunks can't have earlier matches
+        size_t last_chunk = SIZE_MAX;
+        bool done = false;
+    };
+
+    struct Job {
+        size_t search;
+        size_t chunk;
+    };
+
+    // thread body, takes jobs until none are left
+    void work();
+    // merge finished chunks into the search result in order
+    void finish_chunk(Search &s, size_t chunk, size_t bytes);
+
+    std::vector<Search> searches;
+    std::vector<Job> jobs;
+    std::vector<Match> matches;
+    std::atomic<size_t> next_job;
+    size_t bytes_read = 0, bytes_total = 0, chunks_failed = 0;
+    std::mutex merge_mutex;
+    // sources may share a debug handle or file, so reads aren't made concurrently
+    std::mutex read_mutex;
+};
\ No newline at end of file
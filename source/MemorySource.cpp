@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemorySource.hpp"
+
+#include <algorithm>
+
+#include <string.h>
+
+#include <switch.h>
+
+// the console has no mmap, host builds scan dumps straight from the page cache
+#if !defined(__SWITCH__) && defined(__unix__)
+    #include <sys/mman.h>
+    #define FILE_MEMORY_MMAP
+#endif
+
+ProcessMemory::ProcessMemory(u64 tid, u8 seg_mask) {
+    u64 d[8];
+    u64 pid = 0;
+
+    // if not a kernel process, get pid from pm:dmnt
+    if ((tid > 0x0100000000000005) && (tid != 0x0100000000000028)) {
+        pmdmntGetProcessId(&pid, tid);
+
+        if (R_FAILED(svcDebugActiveProcess(&debug_handle, pid)) ||
+            R_FAILED(svcGetDebugEvent(reinterpret_cast<u8 *>(&d), debug_handle)))
+        {
+            return;
+        }
+    } else { // otherwise query svc for the process list
+        u64 pids[300];
+        u32 num_processes;
+
+        svcGetProcessList(&num_processes, pids, 300);
+        u32 i;
+        for (i = 0; i < num_processes - 1; i++) {
+            if (R_SUCCEEDED(svcDebugActiveProcess(&debug_handle, pids[i])) &&
+                R_SUCCEEDED(svcGetDebugEvent(reinterpret_cast<u8 *>(&d), debug_handle)) &&
+                (d[2] == tid))
+            {
+                pid = pids[i];
+                break;
+            }
+            if (debug_handle) svcCloseHandle(debug_handle);
+            debug_handle = INVALID_HANDLE;
+        }
+        if (i == num_processes - 1)
+            return;
+    }
+
+    MemoryInfo mem_info = {};
+
+    u32 page_info;
+    u64 addr = 0;
+    u64 last_text_addr = 0;
+
+    // locate "real" .text segment as Atmosphere emuNAND has two
+    for (;;) {
+        svcQueryDebugProcessMemory(&mem_info, &page_info, debug_handle, addr);
+        if  ((mem_info.perm & Perm_X) &&
+            ((mem_info.type & 0xff) >= MemType_CodeStatic) &&
+            ((mem_info.type & 0xff) < MemType_Heap))
+        {
+            last_text_addr = mem_info.addr;
+        }
+        addr = mem_info.addr + mem_info.size;
+        if (addr == 0) break;
+    }
+
+    addr = last_text_addr;
+    for (u8 segment = 1; segment < BIT(3); )
+    {
+        svcQueryDebugProcessMemory(&mem_info, &page_info, debug_handle, addr);
+        // weird code to allow for bitmasking segments
+        if  ((mem_info.perm & Perm_R) &&
+            ((mem_info.type & 0xff) >= MemType_CodeStatic) &&
+            ((mem_info.type & 0xff) < MemType_Heap) &&
+            ((segment <<= 1) >> 1 & seg_mask) > 0)
+        {
+            segments.push_back({mem_info.addr, total_size, mem_info.size});
+            total_size += mem_info.size;
+        }
+        addr = mem_info.addr + mem_info.size;
+        if (addr == 0) break;
+    }
+
+    set_module_id(tid, pid, last_text_addr);
+}
+
+void ProcessMemory::set_module_id(u64 tid, u64 pid, u64 text_addr) {
+    module_id.resize(MODULE_ID_SIZE);
+    memcpy(module_id.data(), &tid, sizeof(tid));
+
+    LoaderModuleInfo modules[0x10];
+    s32 module_count = 0;
+    if (R_SUCCEEDED(ldrDmntGetProcessModuleInfo(pid, modules, 0x10, &module_count))) {
+        for (s32 i = 0; i < module_count; i++) {
+            if (modules[i].base_address == text_addr) {
+                memcpy(module_id.data() + sizeof(tid), modules[i].build_id, sizeof(modules[i].build_id));
+                return;
+            }
+        }
+    }
+
+    // kips like FS aren't loaded by loader, their segment sizes still tell builds apart
+    std::vector<u64> layout;
+    for (auto &s : segments) {
+        layout.push_back(s.addr - text_addr);
+        layout.push_back(s.size);
+    }
+    sha256CalculateHash(module_id.data() + sizeof(tid), layout.data(), layout.size() * sizeof(u64));
+}
+
+ProcessMemory::~ProcessMemory() {
+    if (debug_handle) svcCloseHandle(debug_handle);
+}
+
+bool ProcessMemory::read(u8 *dest, size_t offset, size_t length) {
+    if (offset + length > total_size)
+        return false;
+
+    for (auto &s : segments) {
+        if (length == 0)
+            break;
+        if (offset >= s.offset + s.size)
+            continue;
+
+        // reads may span the end of one segment and the start of the next
+        size_t part = std::min(length, s.offset + s.size - offset);
+        if (R_FAILED(svcReadDebugProcessMemory(dest, debug_handle, s.addr + offset - s.offset, part)))
+            return false;
+        dest += part;
+        offset += part;
+        length -= part;
+    }
+    return true;
+}
+
+FileMemory::FileMemory(const char *path) {
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return;
+    fseek(file, 0, SEEK_END);
+    file_size = ftell(file);
+
+#ifdef FILE_MEMORY_MMAP
+    if (file_size != 0) {
+        void *m = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (m != MAP_FAILED)
+            mapping = static_cast<const u8 *>(m);
+    }
+#endif
+}
+
+FileMemory::~FileMemory() {
+#ifdef FILE_MEMORY_MMAP
+    if (mapping != nullptr) munmap(const_cast<u8 *>(mapping), file_size);
+#endif
+    if (file != NULL) fclose(file);
+}
+
+bool FileMemory::read(u8 *dest, size_t offset, size_t length) {
+    if ((file == NULL) || (offset + length > file_size))
+        return false;
+    if (mapping != nullptr) {
+        memcpy(dest, mapping + offset, length);
+        return true;
+    }
+    fseek(file, offset, SEEK_SET);
+    return fread(dest, 1, length, file) == length;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <stdio.h>
+
+#include <switch/types.h>
+
+// title id followed by build id
+#define MODULE_ID_SIZE 0x28
+
+// bytes that keys can be searched in without holding them all in memory at once
+class MemorySource {
+public:
+    virtual ~MemorySource() {}
+
+    // total bytes in source
+    virtual size_t size() const = 0;
+    // copy length bytes at offset into dest, false on failure
+    virtual bool read(u8 *dest, size_t offset, size_t length) = 0;
+    // whole source if it's already in memory, nullptr otherwise
+    virtual const u8 *view() const { return nullptr; }
+    // MODULE_ID_SIZE bytes naming the exact build being read, empty if unknown
+    virtual std::vector<u8> get_module_id() const { return {}; }
+};
+
+// requested segments of a running title read on demand, title stays attached until destroyed
+class ProcessMemory : public MemorySource {
+public:
+    ProcessMemory(u64 tid, u8 seg_mask);
+    ~ProcessMemory();
+    ProcessMemory(const ProcessMemory &) = delete;
+    ProcessMemory &operator=(const ProcessMemory &) = delete;
+
+    size_t size() const override { return total_size; }
+    bool read(u8 *dest, size_t offset, size_t length) override;
+    std::vector<u8> get_module_id() const override { return module_id; }
+
+private:
+    // fill module_id from loader, or from the segment layout for kernel processes loader doesn't know
+    void set_module_id(u64 tid, u64 pid, u64 text_addr);
+
+    struct Segment {
+        u64 addr;
+        size_t offset;
+        size_t size;
+    };
+
+    Handle debug_handle = INVALID_HANDLE;
+    // matching segments in address order, offset is where each starts in the source
+    std::vector<Segment> segments;
+    size_t total_size = 0;
+    std::vector<u8> module_id;
+};
+
+// file standing in for process memory, such as a dumped segment, mapped read-only where the host can mmap
+class FileMemory : public MemorySource {
+public:
+    FileMemory(const char *path);
+    ~FileMemory();
+    FileMemory(const FileMemory &) = delete;
+    FileMemory &operator=(const FileMemory &) = delete;
+
+    size_t size() const override { return file_size; }
+    bool read(u8 *dest, size_t offset, size_t length) override;
+    const u8 *view() const override { return mapping; }
+
+private:
+    FILE *file;
+    size_t file_size = 0;
+    // whole file in the page cache, nullptr on the console or if mapping failed
+    const u8 *mapping = nullptr;
+};
\ No newline at end of file
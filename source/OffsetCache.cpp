@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OffsetCache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <switch.h>
+
+void OffsetCache::load() {
+    SetSysFirmwareVersion ver;
+    setsysInitialize();
+    setsysGetFirmwareVersion(&ver);
+    setsysExit();
+    firmware_version = (ver.major << 16) | (ver.minor << 8) | ver.micro;
+
+    FILE *cache_file = fopen(path, "rb");
+    if (cache_file == NULL)
+        return;
+
+    Header header;
+    size_t file_size = 0;
+    if (!fseek(cache_file, 0, SEEK_END))
+        file_size = ftell(cache_file);
+    rewind(cache_file);
+
+    // entry count must match the file size exactly before anything is allocated for it
+    if ((fread(&header, sizeof(header), 1, cache_file) == 1) &&
+        (header.magic == OFFSET_CACHE_MAGIC) &&
+        (header.firmware_version == firmware_version) &&
+        (header.entry_count <= OFFSET_CACHE_MAX_ENTRIES) &&
+        (file_size == sizeof(Header) + header.entry_count * sizeof(Entry)))
+    {
+        entries.resize(header.entry_count);
+        if (fread(entries.data(), sizeof(Entry), entries.size(), cache_file) != entries.size())
+            entries.clear();
+    }
+    fclose(cache_file);
+}
+
+void OffsetCache::save() {
+    if (!changed)
+        return;
+
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (!dir.empty() && !std::filesystem::exists(dir))
+        std::filesystem::create_directory(dir);
+    FILE *cache_file = fopen(path, "wb");
+    if (cache_file == NULL)
+        return;
+
+    Header header = {OFFSET_CACHE_MAGIC, firmware_version, static_cast<u32>(entries.size()), 0};
+    fwrite(&header, sizeof(header), 1, cache_file);
+    fwrite(entries.data(), sizeof(Entry), entries.size(), cache_file);
+    fclose(cache_file);
+    changed = false;
+}
+
+OffsetCache::Entry *OffsetCache::find_entry(const std::vector<u8> &module_id, u64 xx_hash) {
+    for (auto &e : entries) {
+        if ((e.xx_hash == xx_hash) && std::equal(module_id.begin(), module_id.end(), e.module_id))
+            return &e;
+    }
+    return nullptr;
+}
+
+size_t OffsetCache::find_keys(MemorySource &source, const std::vector<Key *> &keys) {
+    std::vector<u8> module_id = source.get_module_id();
+    if (module_id.size() != MODULE_ID_SIZE)
+        return 0;
+
+    size_t keys_found = 0;
+    u8 temp_hash[0x20];
+    byte_vector temp_key;
+    for (auto k : keys) {
+        Entry *e = find_entry(module_id, k->xx_hash);
+        if ((e == nullptr) || k->found())
+            continue;
+
+        temp_key.resize(k->length);
+        if (!source.read(temp_key.data(), e->offset, temp_key.size()))
+            continue;
+        sha256CalculateHash(temp_hash, temp_key.data(), temp_key.size());
+        if (!std::equal(k->hash.begin(), k->hash.end(), temp_hash))
+            continue;
+
+        k->key = temp_key;
+        k->set_found();
+        keys_found++;
+    }
+    return keys_found;
+}
+
+void OffsetCache::set_offset(const MemorySource &source, const Key &key, size_t offset) {
+    std::vector<u8> module_id = source.get_module_id();
+    if (module_id.size() != MODULE_ID_SIZE)
+        return;
+
+    Entry *e = find_entry(module_id, key.xx_hash);
+    if (e == nullptr) {
+        entries.push_back({});
+        e = &entries.back();
+        std::copy(module_id.begin(), module_id.end(), e->module_id);
+        e->xx_hash = key.xx_hash;
+    } else if (e->offset == offset) {
+        return;
+    }
+    e->offset = offset;
+    changed = true;
+}
\ No newline at end of file
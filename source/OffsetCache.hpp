@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Key.hpp"
+#include "MemorySource.hpp"
+
+#include <vector>
+
+#include <switch/types.h>
+
+#define OFFSET_CACHE_PATH "/switch/lockpick/offsets.bin"
+#define OFFSET_CACHE_MAGIC 0x434f504c // "LPOC"
+// a few dozen keys per module build, anything past this is a corrupt file
+#define OFFSET_CACHE_MAX_ENTRIES 0x400
+
+// where keys were found last time, per firmware version and module build
+class OffsetCache {
+public:
+    OffsetCache(const char *path = OFFSET_CACHE_PATH) : path(path) {}
+
+    // load entries saved on the running firmware version, a file that doesn't add up is ignored
+    void load();
+    // write entries if any changed
+    void save();
+
+    // take keys from cached offsets in source after checking their sha256, returns number found
+    size_t find_keys(MemorySource &source, const std::vector<Key *> &keys);
+    // remember offset of key in source
+    void set_offset(const MemorySource &source, const Key &key, size_t offset);
+
+private:
+    struct Entry {
+        u8 module_id[MODULE_ID_SIZE];
+        u64 xx_hash;
+        u64 offset;
+    };
+
+    struct Header {
+        u32 magic;
+        u32 firmware_version;
+        u32 entry_count;
+        u32 reserved;
+    };
+
+    // entry of key in module, nullptr if none
+    Entry *find_entry(const std::vector<u8> &module_id, u64 xx_hash);
+
+    const char *path;
+    std::vector<Entry> entries;
+    u32 firmware_version = 0;
+    bool changed = false;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+#include <stdio.h>
+
+std::mutex Profiler::record_mutex;
+std::vector<Profiler::Record> Profiler::records;
+std::atomic<u32> Profiler::next_thread(0);
+thread_local Profiler::Zone *Profiler::current = nullptr;
+thread_local u32 Profiler::thread = UINT32_MAX;
+
+static const char *counter_names[Profiler::COUNTERS] = {
+    "bytes_read",
+    "hashes",
+    "sha256_confirms",
+    "ipc_calls"
+};
+
+Profiler::Zone::Zone(const char *name) :
+    name(name),
+    parent(current),
+    depth(current != nullptr ? current->depth + 1 : 0),
+    start(now())
+{
+    current = this;
+}
+
+Profiler::Zone::~Zone() {
+    int64_t end = now();
+    current = parent;
+    if (parent != nullptr) {
+        for (size_t i = 0; i < COUNTERS; i++)
+            parent->counters[i] += counters[i];
+    }
+
+    if (thread == UINT32_MAX)
+        thread = next_thread++;
+    Record record = {name, thread, depth, start, end, {}};
+    std::copy(counters, counters + COUNTERS, record.counters);
+    std::lock_guard<std::mutex> lock(record_mutex);
+    records.push_back(record);
+}
+
+int64_t Profiler::Zone::get_elapsed() const {
+    return now() - start;
+}
+
+int64_t Profiler::now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Profiler::save(const char *path) {
+    std::lock_guard<std::mutex> lock(record_mutex);
+    if (records.empty())
+        return false;
+
+    if (!std::filesystem::exists("/switch/lockpick"))
+        std::filesystem::create_directory("/switch/lockpick");
+    FILE *trace_file = fopen(path, "w");
+    if (!trace_file)
+        return false;
+
+    // zones end innermost first, viewers want outer zones first
+    std::vector<Record> sorted(records);
+    std::sort(sorted.begin(), sorted.end(), [](const Record &a, const Record &b) {
+        return (a.start != b.start) ? (a.start < b.start) : (a.depth < b.depth);
+    });
+
+    int64_t base = sorted.front().start;
+    fprintf(trace_file, "{\"traceEvents\":[");
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const Record &r = sorted[i];
+        fprintf(trace_file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%ld,\"dur\":%ld,\"args\":{",
+            (i == 0) ? "" : ",", r.name, r.thread, r.start - base, r.end - r.start);
+        for (size_t j = 0; j < COUNTERS; j++)
+            fprintf(trace_file, "%s\"%s\":%lu", (j == 0) ? "" : ",", counter_names[j], r.counters[j]);
+        fprintf(trace_file, "}}");
+    }
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+    return true;
+}
\ No newline at end of file
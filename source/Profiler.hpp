@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <switch/types.h>
+
+// chrome://tracing file of the last run
+#define PROFILER_TRACE_PATH "/switch/lockpick/trace.json"
+
+class Profiler {
+public:
+    // per-zone counters, totals include zones nested on the same thread
+    enum Counter {
+        BYTES_READ,
+        HASHES,
+        SHA256_CONFIRMS,
+        IPC_CALLS,
+        COUNTERS
+    };
+
+    // times a named phase on the calling thread until it goes out of scope, zones nest
+    class Zone {
+    public:
+        Zone(const char *name);
+        ~Zone();
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+        // microseconds since the zone began
+        int64_t get_elapsed() const;
+
+    private:
+        friend class Profiler;
+
+        const char *name;
+        Zone *parent;
+        u32 depth;
+        int64_t start;
+        u64 counters[COUNTERS] = {};
+    };
+
+    // add to the innermost zone open on the calling thread, dropped if there is none
+    static void count(Counter counter, u64 amount = 1) {
+        if (current != nullptr)
+            current->counters[counter] += amount;
+    }
+
+    // run fun in a zone, returns microseconds taken
+    template<typename FT, typename ... Args>
+    static int64_t profile(const char *name, FT&& fun, Args&&... args) {
+        Zone zone(name);
+        std::invoke(fun, std::forward<Args>(args)...);
+        return zone.get_elapsed();
+    }
+
+    // write every finished zone as chrome trace events
+    static bool save(const char *path);
+
+private:
+    struct Record {
+        const char *name;
+        u32 thread, depth;
+        int64_t start, end;
+        u64 counters[COUNTERS];
+    };
+
+    // microseconds on a monotonic clock
+    static int64_t now();
+
+    static std::mutex record_mutex;
+    static std::vector<Record> records;
+    static std::atomic<u32> next_thread;
+    static thread_local Zone *current;
+    static thread_local u32 thread;
+};
\ No newline at end of file
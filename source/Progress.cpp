@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Progress.hpp"
+
+namespace Progress {
+    std::atomic<u64>
+        bytes_scanned(0),
+        keys_found(0),
+        tickets_processed(0);
+
+    void reset() {
+        bytes_scanned = 0;
+        keys_found = 0;
+        tickets_processed = 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include <switch/types.h>
+
+// counters bumped by worker threads while a phase runs, shown live by the ui thread
+namespace Progress {
+    extern std::atomic<u64>
+        bytes_scanned,
+        keys_found,
+        tickets_processed;
+
+    // zero all counters, called as a phase begins
+    void reset();
+}
\ No newline at end of file
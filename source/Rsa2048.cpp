@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Rsa2048.hpp"
+
+#include <string.h>
+
+typedef unsigned __int128 u128;
+
+// big endian bytes to little endian limbs, value must fit
+static void from_bytes(u64 *dest, const u8 *src, size_t size) {
+    memset(dest, 0, RSA2048_LIMBS * sizeof(u64));
+    for (size_t i = 0; i < size; i++)
+        dest[i / 8] |= static_cast<u64>(src[size - 1 - i]) << (8 * (i % 8));
+}
+
+static void to_bytes(u8 *dest, const u64 *src) {
+    for (size_t i = 0; i < RSA2048_LIMBS * 8; i++)
+        dest[RSA2048_LIMBS * 8 - 1 - i] = (src[i / 8] >> (8 * (i % 8))) & 0xff;
+}
+
+// dest = a - b if a (with carry above its top limb) is at least b, else a, without branching
+static void sub_if_not_less(u64 *dest, const u64 *a, u64 carry, const u64 *b) {
+    u64 diff[RSA2048_LIMBS], borrow = 0;
+    for (size_t i = 0; i < RSA2048_LIMBS; i++) {
+        u128 d = static_cast<u128>(a[i]) - b[i] - borrow;
+        diff[i] = static_cast<u64>(d);
+        borrow = static_cast<u64>(d >> 64) & 1;
+    }
+    // all ones when the subtraction didn't wrap
+    u64 mask = 0 - static_cast<u64>(carry >= borrow);
+    for (size_t i = 0; i < RSA2048_LIMBS; i++)
+        dest[i] = (diff[i] & mask) | (a[i] & ~mask);
+}
+
+Rsa2048::Rsa2048(const u8 *N) {
+    from_bytes(n, N, RSA2048_LIMBS * 8);
+
+    // newton iteration doubles the correct low bits each round, n0 is its own inverse mod 8
+    u64 inv = n[0];
+    for (size_t i = 0; i < 5; i++)
+        inv *= 2 - n[0] * inv;
+    n0_inv = 0 - inv;
+
+    // double 1 mod N 4096 times
+    memset(r2, 0, sizeof(r2));
+    r2[0] = 1;
+    for (size_t i = 0; i < 2 * RSA2048_LIMBS * 64; i++) {
+        u64 carry = r2[RSA2048_LIMBS - 1] >> 63;
+        for (size_t j = RSA2048_LIMBS - 1; j > 0; j--)
+            r2[j] = (r2[j] << 1) | (r2[j - 1] >> 63);
+        r2[0] <<= 1;
+        sub_if_not_less(r2, r2, carry, n);
+    }
+}
+
+// coarsely integrated operand scanning, t stays below 2N so one final subtraction reduces it
+void Rsa2048::mont_mul(u64 *out, const u64 *a, const u64 *b) const {
+    u64 t[RSA2048_LIMBS + 2] = {};
+    for (size_t i = 0; i < RSA2048_LIMBS; i++) {
+        u128 carry = 0;
+        for (size_t j = 0; j < RSA2048_LIMBS; j++) {
+            carry += static_cast<u128>(a[j]) * b[i] + t[j];
+            t[j] = static_cast<u64>(carry);
+            carry >>= 64;
+        }
+        carry += t[RSA2048_LIMBS];
+        t[RSA2048_LIMBS] = static_cast<u64>(carry);
+        t[RSA2048_LIMBS + 1] = static_cast<u64>(carry >> 64);
+
+        // add m * N so the low limb becomes zero, then shift it out
+        u64 m = t[0] * n0_inv;
+        carry = (static_cast<u128>(m) * n[0] + t[0]) >> 64;
+        for (size_t j = 1; j < RSA2048_LIMBS; j++) {
+            carry += static_cast<u128>(m) * n[j] + t[j];
+            t[j - 1] = static_cast<u64>(carry);
+            carry >>= 64;
+        }
+        carry += t[RSA2048_LIMBS];
+        t[RSA2048_LIMBS - 1] = static_cast<u64>(carry);
+        t[RSA2048_LIMBS] = t[RSA2048_LIMBS + 1] + static_cast<u64>(carry >> 64);
+    }
+    sub_if_not_less(out, t, t[RSA2048_LIMBS], n);
+}
+
+void Rsa2048::exp_mod(const u8 *input, const u8 *exp, size_t exp_size, u8 *dest) const {
+    u64 one[RSA2048_LIMBS] = {1}, x[RSA2048_LIMBS], picked[RSA2048_LIMBS];
+    u64 table[1 << RSA2048_WINDOW][RSA2048_LIMBS];
+
+    // powers 0 to 15 of input in Montgomery form
+    from_bytes(x, input, RSA2048_LIMBS * 8);
+    mont_mul(table[1], x, r2);
+    mont_mul(table[0], r2, one);
+    for (size_t i = 2; i < (1 << RSA2048_WINDOW); i++)
+        mont_mul(table[i], table[i - 1], table[1]);
+
+    memcpy(x, table[0], sizeof(x));
+    for (size_t i = 0; i < exp_size * 8; i += RSA2048_WINDOW) {
+        for (size_t j = 0; j < RSA2048_WINDOW; j++)
+            mont_mul(x, x, x);
+
+        // read every table entry so the lookup doesn't leak the exponent through the cache
+        u64 window = (exp[i / 8] >> (8 - RSA2048_WINDOW - (i % 8))) & ((1 << RSA2048_WINDOW) - 1);
+        memset(picked, 0, sizeof(picked));
+        for (u64 k = 0; k < (1 << RSA2048_WINDOW); k++) {
+            u64 mask = 0 - static_cast<u64>(k == window);
+            for (size_t j = 0; j < RSA2048_LIMBS; j++)
+                picked[j] |= table[k][j] & mask;
+        }
+        mont_mul(x, x, picked);
+    }
+
+    mont_mul(x, x, one);
+    to_bytes(dest, x);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <switch/types.h>
+
+// 64 bit limbs in a 2048 bit number
+#define RSA2048_LIMBS 32
+// exponent bits consumed per table lookup
+#define RSA2048_WINDOW 4
+
+/*
+    software RSA-2048 modexp with Montgomery multiplication
+    runs in constant time for a given exponent size and needs no service, so calls can run on every core
+*/
+class Rsa2048 {
+public:
+    // N is 0x100 bytes big endian and must be odd
+    Rsa2048(const u8 *N);
+
+    // dest = input ^ exp mod N, same argument order as splUserExpMod
+    void exp_mod(const u8 *input, const u8 *exp, size_t exp_size, u8 *dest) const;
+
+private:
+    // out = a * b / R mod N with R = 2^2048
+    void mont_mul(u64 *out, const u64 *a, const u64 *b) const;
+
+    // little endian limbs
+    u64 n[RSA2048_LIMBS];
+    // R^2 mod N, converts into Montgomery form
+    u64 r2[RSA2048_LIMBS];
+    // -N^-1 mod 2^64
+    u64 n0_inv;
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TicketBlockCache.hpp"
+
+#include "FileExtents.hpp"
+
+#include <algorithm>
+#include <filesystem>
+
+#include <stdio.h>
+
+void TicketBlockCache::load() {
+    FILE *cache_file = fopen(path, "rb");
+    if (cache_file == NULL)
+        return;
+
+    Header header;
+    size_t file_size = 0;
+    if (!fseek(cache_file, 0, SEEK_END))
+        file_size = ftell(cache_file);
+    rewind(cache_file);
+
+    if ((fread(&header, sizeof(header), 1, cache_file) != 1) || (header.magic != TICKET_BLOCK_CACHE_MAGIC)) {
+        fclose(cache_file);
+        return;
+    }
+
+    // block counts must fit their save and add up to the file size before anything is allocated for them
+    size_t total_blocks = 0;
+    for (size_t i = 0; i < TICKET_SAVES; i++) {
+        if ((header.block_counts[i] > TICKET_BLOCK_CACHE_MAX_BLOCKS) ||
+            (header.block_counts[i] > header.save_sizes[i] / TICKET_BLOCK_SIZE))
+        {
+            fclose(cache_file);
+            return;
+        }
+        total_blocks += header.block_counts[i];
+    }
+    if (file_size != sizeof(Header) + total_blocks * sizeof(u32)) {
+        fclose(cache_file);
+        return;
+    }
+
+    for (size_t i = 0; i < TICKET_SAVES; i++) {
+        save_sizes[i] = header.save_sizes[i];
+        blocks[i].resize(header.block_counts[i]);
+        if (fread(blocks[i].data(), sizeof(u32), blocks[i].size(), cache_file) != blocks[i].size()) {
+            for (size_t j = 0; j < TICKET_SAVES; j++) {
+                blocks[j].clear();
+                save_sizes[j] = 0;
+            }
+            break;
+        }
+    }
+    fclose(cache_file);
+}
+
+void TicketBlockCache::save() {
+    if (!changed)
+        return;
+
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (!dir.empty() && !std::filesystem::exists(dir))
+        std::filesystem::create_directory(dir);
+    FILE *cache_file = fopen(path, "wb");
+    if (cache_file == NULL)
+        return;
+
+    Header header = {TICKET_BLOCK_CACHE_MAGIC, 0, {}, {}};
+    for (size_t i = 0; i < TICKET_SAVES; i++) {
+        header.save_sizes[i] = save_sizes[i];
+        header.block_counts[i] = blocks[i].size();
+    }
+    fwrite(&header, sizeof(header), 1, cache_file);
+    for (auto &b : blocks)
+        fwrite(b.data(), sizeof(u32), b.size(), cache_file);
+    fclose(cache_file);
+    changed = false;
+}
+
+bool TicketBlockCache::read_block(const u8 *block, const std::function<bool(const u8 *record)> &handle_record, bool &done) {
+    bool has_tickets = false;
+    for (size_t i = 0; !done && (i < TICKET_BLOCK_SIZE); i += TICKET_RECORD_SIZE) {
+        // records are packed from the start of the block, the first one without an RSA-2048 signature ends them
+        if (*reinterpret_cast<const u32 *>(block + i) != 0x10004)
+            break;
+        has_tickets = true;
+        done = handle_record(block + i);
+    }
+    return has_tickets;
+}
+
+size_t TicketBlockCache::read_tickets(FIL &file, size_t save, const std::function<bool(const u8 *record)> &handle_record) {
+    std::vector<u8> buffer(TICKET_BUFFER_SIZE);
+    std::vector<u32> ticket_blocks;
+    std::vector<bool> blocks_read(f_size(&file) / TICKET_BLOCK_SIZE);
+    bool done = false;
+    size_t blocks_total = 0;
+    FileExtents extents;
+    extents.map(file);
+
+    if (save_sizes[save] == f_size(&file)) {
+        for (u32 b : blocks[save]) {
+            if ((b >= blocks_read.size()) || blocks_read[b])
+                continue;
+            if (!extents.read(buffer.data(), static_cast<u64>(b) * TICKET_BLOCK_SIZE, TICKET_BLOCK_SIZE))
+                continue;
+            blocks_read[b] = true;
+            blocks_total++;
+            if (read_block(buffer.data(), handle_record, done))
+                ticket_blocks.push_back(b);
+            if (done)
+                break;
+        }
+    }
+
+    // fall back to scanning blocks the cache didn't cover
+    for (u32 b = 0; !done && (b < blocks_read.size()); ) {
+        u32 count = std::min<u32>(TICKET_BUFFER_SIZE / TICKET_BLOCK_SIZE, blocks_read.size() - b);
+        if (!extents.read(buffer.data(), static_cast<u64>(b) * TICKET_BLOCK_SIZE, static_cast<u64>(count) * TICKET_BLOCK_SIZE))
+            break;
+        for (u32 i = 0; !done && (i < count); i++, b++) {
+            if (blocks_read[b])
+                continue;
+            blocks_total++;
+            if (read_block(buffer.data() + i * TICKET_BLOCK_SIZE, handle_record, done))
+                ticket_blocks.push_back(b);
+        }
+    }
+    std::sort(ticket_blocks.begin(), ticket_blocks.end());
+
+    if ((save_sizes[save] != f_size(&file)) || (ticket_blocks != blocks[save])) {
+        save_sizes[save] = f_size(&file);
+        blocks[save] = ticket_blocks;
+        changed = true;
+    }
+    return blocks_total;
+}
\ No newline at end of file
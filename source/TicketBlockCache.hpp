@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <switch/types.h>
+
+#include "fatfs/ff.h"
+
+#define TICKET_BLOCK_CACHE_PATH "/switch/lockpick/ticket_blocks.bin"
+#define TICKET_BLOCK_CACHE_MAGIC 0x4254504c // "LPTB"
+// ticket saves cached, 80000000000000e1 and 80000000000000e2
+#define TICKET_SAVES 2
+// far more blocks than a ticket save has, larger counts mean a corrupt file
+#define TICKET_BLOCK_CACHE_MAX_BLOCKS 0x10000
+// tickets sit at the start of 0x4000 byte blocks of the save, packed in 0x400 byte records
+#define TICKET_BLOCK_SIZE 0x4000
+#define TICKET_RECORD_SIZE 0x400
+// bytes read at once while scanning a whole save, a single storage read when the save isn't fragmented there
+#define TICKET_BUFFER_SIZE 0x100000
+
+/*
+    which blocks of each ticket save held tickets last time, so later runs read only those unless a ticket is missing
+    this only remembers block numbers, the save file is still opened through fatfs and not parsed as a save
+*/
+class TicketBlockCache {
+public:
+    TicketBlockCache(const char *path = TICKET_BLOCK_CACHE_PATH) : path(path) {}
+
+    // load block lists, a file that doesn't add up is ignored
+    void load();
+    // write block lists if any changed
+    void save();
+
+    /*
+        pass each ticket record of save to handle_record until it returns true
+        cached blocks are read first if the save kept its size, the rest is only scanned if handle_record still wants more
+        returns how many blocks were read
+    */
+    size_t read_tickets(FIL &file, size_t save, const std::function<bool(const u8 *record)> &handle_record);
+
+    // blocks remembered for save
+    const std::vector<u32> &get_blocks(size_t save) const { return blocks[save]; }
+
+private:
+    struct Header {
+        u32 magic;
+        u32 reserved;
+        // blocks of each save follow in save order
+        u64 save_sizes[TICKET_SAVES];
+        u32 block_counts[TICKET_SAVES];
+    };
+
+    // hand records of block to handle_record, returns whether it holds tickets and sets done once handle_record does
+    bool read_block(const u8 *block, const std::function<bool(const u8 *record)> &handle_record, bool &done);
+
+    const char *path;
+    std::vector<u32> blocks[TICKET_SAVES];
+    u64 save_sizes[TICKET_SAVES] = {};
+    bool changed = false;
+};
\ No newline at end of file
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TicketDecryptor.hpp"
+
+#include "Profiler.hpp"
+#include "Progress.hpp"
+
+#include <algorithm>
+
+#include <time.h>
+
+#include <switch.h>
+
+// hash of empty string
+const u8 TicketDecryptor::null_hash[0x20] = {
+        0xE3, 0xB0, 0xC4, 0x42, 0x98, 0xFC, 0x1C, 0x14, 0x9A, 0xFB, 0xF4, 0xC8, 0x99, 0x6F, 0xB9, 0x24,
+        0x27, 0xAE, 0x41, 0xE4, 0x64, 0x9B, 0x93, 0x4C, 0xA4, 0x95, 0x99, 0x1B, 0x78, 0x52, 0xB8, 0x55};
+
+TicketDecryptor::TicketDecryptor(const u8 *D, const u8 *N, bool local_exp_mod, TitlekeyMap &titlekeys) :
+    D(D),
+    N(N),
+    local_exp_mod(local_exp_mod),
+    rsa(N),
+    titlekeys(titlekeys)
+{
+}
+
+void TicketDecryptor::start() {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    std::lock_guard<std::mutex> lock(ticket_mutex);
+    collecting = true;
+    // only threads that started count, unmask threads wait for every counted modexp thread
+    for (size_t i = 0; i < (local_exp_mod ? TICKET_EXP_MOD_THREADS : 1); i++) {
+        workers.emplace_back(new CoreThread(workers.size(), [this] { exp_mod(); }));
+        if (workers.back()->started())
+            exp_mod_started++;
+    }
+    for (size_t i = 0; i < TICKET_UNMASK_THREADS; i++) {
+        workers.emplace_back(new CoreThread(workers.size(), [this] { unmask(); }));
+        if (workers.back()->started())
+            unmask_started++;
+    }
+    exp_mod_threads = exp_mod_started;
+}
+
+void TicketDecryptor::add(size_t slot, const u8 *titlekey_block) {
+    std::lock_guard<std::mutex> lock(ticket_mutex);
+    tickets.emplace_back();
+    tickets.back().slot = slot;
+    std::copy(titlekey_block, titlekey_block + 0x100, tickets.back().block);
+    ticket_ready.notify_all();
+}
+
+void TicketDecryptor::finish() {
+    {
+        std::lock_guard<std::mutex> lock(ticket_mutex);
+        collecting = false;
+        if (exp_mod_started == 0)
+            exp_mod_threads = 1;
+        ticket_ready.notify_all();
+    }
+    // a stage none of whose threads started runs here now that every ticket is queued
+    if (exp_mod_started == 0)
+        exp_mod();
+    if (unmask_started == 0)
+        unmask();
+    for (auto &t : workers)
+        t->join();
+    workers.clear();
+    exp_mod_started = unmask_started = 0;
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    busy_seconds += (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+    if (busy_seconds > 0)
+        tickets_per_second = tickets.size() / busy_seconds;
+}
+
+size_t TicketDecryptor::decrypt_save(TicketBlockCache &ticket_blocks, FIL &file, size_t save) {
+    // titlekey blocks queued for each slot, so copies are only tried once
+    std::vector<std::vector<u8>> tried(titlekeys.get_slot_count());
+    auto queue = [&](size_t slot, const u8 *titlekey_block) {
+        add(slot, titlekey_block);
+        tried[slot].insert(tried[slot].end(), titlekey_block, titlekey_block + 0x100);
+    };
+    auto was_tried = [&](size_t slot, const u8 *titlekey_block) {
+        for (auto it = tried[slot].begin(); it != tried[slot].end(); it += 0x100) {
+            if (std::equal(it, it + 0x100, titlekey_block))
+                return true;
+        }
+        return false;
+    };
+
+    // slots without a titlekey or a copy on the way, decryption lags reading so set slots alone would never stop it
+    size_t uncovered = titlekeys.get_slot_count() - titlekeys.get_count();
+    start();
+    size_t blocks_read = ticket_blocks.read_tickets(file, save, [&](const u8 *record) {
+        // skip if rights id not reported by es, already set or already queued
+        size_t slot = titlekeys.find(record + 0x2a0);
+        if ((slot != TITLEKEY_NOT_FOUND) && tried[slot].empty() && !titlekeys.is_set(slot)) {
+            queue(slot, record + 0x180);
+            uncovered--;
+        }
+        return uncovered == 0;
+    });
+    finish();
+
+    bool retry = false;
+    for (size_t slot = 0; slot < tried.size(); slot++)
+        retry |= !tried[slot].empty() && !titlekeys.is_set(slot);
+    if (!retry)
+        return blocks_read;
+
+    // older copies of a ticket that failed may still decrypt, so the whole save is read for them
+    start();
+    blocks_read += ticket_blocks.read_tickets(file, save, [&](const u8 *record) {
+        size_t slot = titlekeys.find(record + 0x2a0);
+        if ((slot != TITLEKEY_NOT_FOUND) && !tried[slot].empty() && !titlekeys.is_set(slot) && !was_tried(slot, record + 0x180))
+            queue(slot, record + 0x180);
+        return false;
+    });
+    finish();
+    return blocks_read;
+}
+
+void TicketDecryptor::exp_mod() {
+    Profiler::Zone zone("TicketDecryptor::exp_mod");
+    std::unique_lock<std::mutex> lock(ticket_mutex);
+    for (;;) {
+        ticket_ready.wait(lock, [this] { return (next_exp_mod < tickets.size()) || !collecting; });
+        if (next_exp_mod == tickets.size())
+            break;
+
+        Ticket &t = tickets[next_exp_mod++];
+        lock.unlock();
+        if (local_exp_mod)
+            rsa.exp_mod(t.block, D, 0x100, t.M);
+        else
+            splUserExpMod(t.block, N, D, 0x100, t.M);
+        if (!local_exp_mod)
+            Profiler::count(Profiler::IPC_CALLS);
+        lock.lock();
+
+        t.exp_mod_done = true;
+        ticket_ready.notify_all();
+    }
+    // let unmask threads see nothing else is coming once the last modexp finished
+    exp_mod_threads--;
+    ticket_ready.notify_all();
+}
+
+void TicketDecryptor::unmask() {
+    Profiler::Zone zone("TicketDecryptor::unmask");
+    std::unique_lock<std::mutex> lock(ticket_mutex);
+    for (;;) {
+        ticket_ready.wait(lock, [this] { return ((next_unmask < tickets.size()) && tickets[next_unmask].exp_mod_done) || (exp_mod_threads == 0); });
+        if (next_unmask == tickets.size())
+            break;
+
+        Ticket &t = tickets[next_unmask++];
+        lock.unlock();
+
+        // decrypts the titlekey from personalized ticket
+        u8 db[0xdf];
+        if (oaep_decode(t.M, db))
+            titlekeys.set(t.slot, db + 0xcf);
+        Progress::tickets_processed++;
+
+        lock.lock();
+    }
+}
+
+void TicketDecryptor::mgf1_xor(const u8 *data, size_t data_length, u8 *dest, size_t dest_length) {
+    Sha256Context data_context;
+    sha256ContextCreate(&data_context);
+    sha256ContextUpdate(&data_context, data, data_length);
+
+    u8 mask[0x20];
+    for (u32 i = 0; i * 0x20 < dest_length; i++) {
+        Sha256Context context = data_context;
+        u8 counter[4] = {static_cast<u8>(i >> 24), static_cast<u8>(i >> 16), static_cast<u8>(i >> 8), static_cast<u8>(i)};
+        sha256ContextUpdate(&context, counter, sizeof(counter));
+        sha256ContextGetHash(&context, mask);
+        for (size_t j = 0; (j < 0x20) && (i * 0x20 + j < dest_length); j++)
+            dest[i * 0x20 + j] ^= mask[j];
+    }
+}
+
+bool TicketDecryptor::oaep_decode(const u8 *M, u8 *db) {
+    // seed is masked by db and db by seed
+    u8 salt[0x20];
+    std::copy(M + 1, M + 0x21, salt);
+    mgf1_xor(M + 0x21, 0xdf, salt, 0x20);
+
+    std::copy(M + 0x21, M + 0x100, db);
+    mgf1_xor(salt, 0x20, db, 0xdf);
+
+    // verify it starts with hash of null string
+    return std::equal(db, db + 0x20, null_hash);
+}
\ No newline at end of file
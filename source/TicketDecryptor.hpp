@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "CoreThread.hpp"
+#include "Rsa2048.hpp"
+#include "TicketBlockCache.hpp"
+#include "TitlekeyMap.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <switch/types.h>
+
+// threads unmasking decrypted ticket blocks
+#define TICKET_UNMASK_THREADS 2
+// threads running modexp with the local backend, spl only takes one request at a time
+#define TICKET_EXP_MOD_THREADS 3
+
+/*
+    pipeline decrypting titlekeys of personalized tickets
+    the caller collects ticket blocks, modexp threads decrypt them and others strip the OAEP padding
+*/
+class TicketDecryptor {
+public:
+    // D and N of the eticket RSA keypair, must outlive finish()
+    // local_exp_mod runs modexp with Rsa2048 on TICKET_EXP_MOD_THREADS instead of splUserExpMod
+    // titlekeys that decrypt correctly are set in titlekeys
+    TicketDecryptor(const u8 *D, const u8 *N, bool local_exp_mod, TitlekeyMap &titlekeys);
+
+    // start pipeline threads, can start again after finish()
+    void start();
+    // queue 0x100 byte titlekey block of ticket for slot of titlekeys, the first copy that decrypts sets the slot
+    void add(size_t slot, const u8 *titlekey_block);
+    // wait for every queued ticket
+    void finish();
+
+    /*
+        decrypt tickets of save for slots of titlekeys not set yet, returns how many blocks of save were read
+        one copy per slot is queued and reading stops once every slot has one on the way,
+        slots whose copies all failed then get the copies not tried yet from the rest of the save
+    */
+    size_t decrypt_save(TicketBlockCache &ticket_blocks, FIL &file, size_t save);
+
+    // tickets through the pipeline per second while it was running
+    float get_tickets_per_second() const { return tickets_per_second; }
+
+    // xor MGF1 mask of data into dest, the hash of data is computed once and reused for every counter
+    static void mgf1_xor(const u8 *data, size_t data_length, u8 *dest, size_t dest_length);
+    // strip OAEP padding of decrypted block M into 0xdf byte db, returns whether its label hash is the empty one
+    static bool oaep_decode(const u8 *M, u8 *db);
+
+private:
+    struct Ticket {
+        size_t slot;
+        u8 block[0x100];
+        u8 M[0x100];
+        bool exp_mod_done = false;
+    };
+
+    // thread bodies for the two stages
+    void exp_mod();
+    void unmask();
+
+    const u8 *D, *N;
+    bool local_exp_mod;
+    Rsa2048 rsa;
+
+    // tickets never move once queued so stages can work on them without the lock
+    std::deque<Ticket> tickets;
+    size_t next_exp_mod = 0, next_unmask = 0, exp_mod_threads = 0;
+    // threads of each stage that started
+    size_t exp_mod_started = 0, unmask_started = 0;
+    bool collecting = false;
+    std::mutex ticket_mutex;
+    std::condition_variable ticket_ready;
+
+    // exp_mod threads are spread over the cores first, unmask threads share them
+    std::vector<std::unique_ptr<CoreThread>> workers;
+    TitlekeyMap &titlekeys;
+    struct timespec start_time;
+    // between every start() and finish() so far
+    float busy_seconds = 0;
+    float tickets_per_second = 0;
+
+    // hash of empty string used to verify titlekeys
+    static const u8 null_hash[0x20];
+};
\ No newline at end of file
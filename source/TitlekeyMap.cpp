@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TitlekeyMap.hpp"
+
+#include <algorithm>
+
+#include <string.h>
+
+TitlekeyMap::TitlekeyMap(const RightsId *rights_ids, size_t count) {
+    slots.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        slots[i].rights_id = rights_ids[i];
+        slots[i].is_set = false;
+    }
+
+    auto less = [](const Slot &a, const Slot &b) { return memcmp(a.rights_id.c, b.rights_id.c, 0x10) < 0; };
+    auto equal = [](const Slot &a, const Slot &b) { return memcmp(a.rights_id.c, b.rights_id.c, 0x10) == 0; };
+    std::sort(slots.begin(), slots.end(), less);
+    slots.erase(std::unique(slots.begin(), slots.end(), equal), slots.end());
+}
+
+size_t TitlekeyMap::find(const u8 *rights_id) const {
+    auto it = std::lower_bound(slots.begin(), slots.end(), rights_id,
+        [](const Slot &s, const u8 *id) { return memcmp(s.rights_id.c, id, 0x10) < 0; });
+    if ((it == slots.end()) || (memcmp(it->rights_id.c, rights_id, 0x10) != 0))
+        return TITLEKEY_NOT_FOUND;
+    return it - slots.begin();
+}
+
+bool TitlekeyMap::is_set(size_t slot) const {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    return slots[slot].is_set;
+}
+
+bool TitlekeyMap::set(size_t slot, const u8 *titlekey) {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    if (slots[slot].is_set)
+        return false;
+    std::copy(titlekey, titlekey + 0x10, slots[slot].titlekey);
+    slots[slot].is_set = true;
+    titlekey_count++;
+    return true;
+}
+
+size_t TitlekeyMap::get_count() const {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    return titlekey_count;
+}
+
+void TitlekeyMap::save(FILE *file) const {
+    std::lock_guard<std::mutex> lock(slot_mutex);
+    static const char hex[] = "0123456789abcdef";
+    char line[0x20 + 3 + 0x20 + 1];
+    for (auto &s : slots) {
+        if (!s.is_set)
+            continue;
+        for (size_t i = 0; i < 0x10; i++) {
+            line[i*2] = hex[s.rights_id.c[i] >> 4];
+            line[i*2 + 1] = hex[s.rights_id.c[i] & 0xf];
+            line[0x23 + i*2] = hex[s.titlekey[i] >> 4];
+            line[0x23 + i*2 + 1] = hex[s.titlekey[i] & 0xf];
+        }
+        memcpy(line + 0x20, " = ", 3);
+        line[0x43] = '\n';
+        fwrite(line, 1, 0x44, file);
+    }
+}
\ No newline at end of file
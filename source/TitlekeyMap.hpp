@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+
+#include <switch/types.h>
+
+extern "C" {
+    #include "nx/es.h"
+}
+
+// slot of a rights id not in the map
+#define TITLEKEY_NOT_FOUND SIZE_MAX
+
+/*
+    titlekeys by binary rights id, ids are sorted once so lookups are a binary search without hex strings or allocation
+    slots are checked by the ticket reader and set by decryptor threads, so slot state is only touched under a lock
+*/
+class TitlekeyMap {
+public:
+    // rights ids reported by es, duplicates are dropped
+    TitlekeyMap(const RightsId *rights_ids, size_t count);
+
+    // slot of 0x10 byte rights id, TITLEKEY_NOT_FOUND if not reported
+    size_t find(const u8 *rights_id) const;
+    // whether a titlekey was set for slot yet
+    bool is_set(size_t slot) const;
+    // set titlekey of slot unless a copy of the ticket already did, returns whether it was set
+    bool set(size_t slot, const u8 *titlekey);
+
+    // titlekeys set so far
+    size_t get_count() const;
+    // distinct rights ids, all titlekeys are found once get_count reaches this
+    size_t get_slot_count() const { return slots.size(); }
+    // write "rights id = titlekey" lines of set slots
+    void save(FILE *file) const;
+
+private:
+    struct Slot {
+        RightsId rights_id;
+        u8 titlekey[0x10];
+        bool is_set;
+    };
+
+    // sorted rights ids never change after construction, find() reads them without the lock
+    std::vector<Slot> slots;
+    size_t titlekey_count = 0;
+    mutable std::mutex slot_mutex;
+};
\ No newline at end of file
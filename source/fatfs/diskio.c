@@ -10,9 +10,100 @@
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 
+#include <stdio.h>
+#include <string.h>
 #include <switch.h>
 
 extern FsStorage storage;
+extern FILE *storage_image;
+
+/* Sectors are cached in whole lines so walking the FAT and directories doesn't turn into one storage read per sector */
+#define DISK_CACHE_LINE_SIZE	0x10000
+#define DISK_CACHE_LINES		16
+#define DISK_CACHE_LINE_SECTORS	(DISK_CACHE_LINE_SIZE / FF_MAX_SS)
+#define DISK_CACHE_EMPTY		UINT64_MAX
+
+typedef struct {
+    u64 line;		/* Index of the line held, DISK_CACHE_EMPTY if none */
+    u64 last_used;
+    u64 size;		/* Bytes read, short for the last line of the storage */
+    BYTE data[DISK_CACHE_LINE_SIZE];
+} cache_line_t;
+
+static cache_line_t cache[DISK_CACHE_LINES];
+static u64 cache_clock, last_miss_line = DISK_CACHE_EMPTY, storage_size;
+static DWORD cache_hits, cache_misses, cache_readaheads, storage_reads;
+
+/* Read from the SYSTEM storage or its image */
+static int storage_read(BYTE *buff, u64 offset, u64 size)
+{
+    storage_reads++;
+    if (storage_image)
+        return !fseek(storage_image, (long)offset, SEEK_SET) && (fread(buff, 1, size, storage_image) == size);
+    return R_SUCCEEDED(fsStorageRead(&storage, offset, buff, size));
+}
+
+/* Read line into the least recently used slot */
+static cache_line_t *fill_line(u64 line)
+{
+    cache_line_t *victim = &cache[0];
+    for (UINT i = 1; i < DISK_CACHE_LINES; i++) {
+        if (cache[i].last_used < victim->last_used)
+            victim = &cache[i];
+    }
+
+    u64 offset = line * DISK_CACHE_LINE_SIZE;
+    victim->line = DISK_CACHE_EMPTY;
+    victim->last_used = ++cache_clock;
+    if (offset >= storage_size)
+        return NULL;
+    victim->size = storage_size - offset < DISK_CACHE_LINE_SIZE ? storage_size - offset : DISK_CACHE_LINE_SIZE;
+    if (!storage_read(victim->data, offset, victim->size))
+        return NULL;
+    victim->line = line;
+    return victim;
+}
+
+static cache_line_t *find_line(u64 line)
+{
+    for (UINT i = 0; i < DISK_CACHE_LINES; i++) {
+        if (cache[i].line == line)
+            return &cache[i];
+    }
+    return NULL;
+}
+
+static cache_line_t *get_line(u64 line)
+{
+    cache_line_t *l = find_line(line);
+    if (l) {
+        cache_hits++;
+        l->last_used = ++cache_clock;
+        return l;
+    }
+
+    cache_misses++;
+    l = fill_line(line);
+    if (l && (last_miss_line != DISK_CACHE_EMPTY) && (line == last_miss_line + 1) && !find_line(line + 1)) {
+        /* Sequential misses, fetch the next line before it's asked for */
+        if (fill_line(line + 1)) {
+            cache_readaheads++;
+            line++;
+        }
+    }
+    last_miss_line = line;
+    return l;
+}
+
+void disk_cache_get_stats(DWORD *hits, DWORD *misses, DWORD *readaheads, DWORD *reads)
+{
+    *hits = cache_hits;
+    *misses = cache_misses;
+    *readaheads = cache_readaheads;
+    *reads = storage_reads;
+}
+
+
 
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
@@ -35,6 +126,23 @@ DSTATUS disk_initialize (
     BYTE pdrv				/* Physical drive nmuber to identify the drive */
 )
 {
+    /* Called on every mount, the storage behind it may have changed */
+    for (UINT i = 0; i < DISK_CACHE_LINES; i++) {
+        cache[i].line = DISK_CACHE_EMPTY;
+        cache[i].last_used = 0;
+    }
+    last_miss_line = DISK_CACHE_EMPTY;
+
+    if (storage_image) {
+        if (fseek(storage_image, 0, SEEK_END))
+            return STA_NOINIT;
+        storage_size = ftell(storage_image);
+    } else {
+        s64 size;
+        if (R_FAILED(fsStorageGetSize(&storage, &size)))
+            return STA_NOINIT;
+        storage_size = size;
+    }
     return 0;
 }
 
@@ -51,9 +159,25 @@ DRESULT disk_read (
     UINT count		/* Number of sectors to read */
 )
 {
-    if (R_SUCCEEDED(fsStorageRead(&storage, FF_MAX_SS * sector, buff, FF_MAX_SS * count)))
-        return RES_OK;
-    return RES_ERROR;
+    /* Reads of a line or more are file data, pass them straight through */
+    if (count >= DISK_CACHE_LINE_SECTORS)
+        return storage_read(buff, (u64)FF_MAX_SS * sector, (u64)FF_MAX_SS * count) ? RES_OK : RES_ERROR;
+
+    while (count > 0) {
+        cache_line_t *l = get_line(sector / DISK_CACHE_LINE_SECTORS);
+        u64 offset = (u64)(sector % DISK_CACHE_LINE_SECTORS) * FF_MAX_SS;
+        UINT n = DISK_CACHE_LINE_SECTORS - sector % DISK_CACHE_LINE_SECTORS;
+        if (n > count)
+            n = count;
+        if (!l || (offset + (u64)n * FF_MAX_SS > l->size))
+            return RES_ERROR;
+
+        memcpy(buff, l->data + offset, n * FF_MAX_SS);
+        buff += n * FF_MAX_SS;
+        sector += n;
+        count -= n;
+    }
+    return RES_OK;
 }
 
 
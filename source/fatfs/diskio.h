@@ -31,6 +31,7 @@ DSTATUS disk_status (BYTE pdrv);
 DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
+void disk_cache_get_stats (DWORD* hits, DWORD* misses, DWORD* readaheads, DWORD* reads);
 
 
 /* Disk Status Bits (DSTATUS) */
@@ -18,11 +18,13 @@
 
 #include "Common.hpp"
 #include "KeyCollection.hpp"
+#include "Profiler.hpp"
 
 extern "C" void userAppInit()
 {
     plInitialize();
     pmdmntInitialize();
+    ldrDmntInitialize();
     splInitialize();
 }
 
@@ -30,14 +32,24 @@ extern "C" void userAppExit()
 {
     plExit();
     pmdmntExit();
+    ldrDmntExit();
     splExit();
 }
 
 int main(int argc, char **argv) {
     Common::intro();
 
-    KeyCollection Keys;
-    Keys.get_keys();
+    // recorded consoles are only read when asked for with "--offline [dir]" or "--fleet [dir]"
+    std::string mode = (argc > 1) ? argv[1] : "";
+    std::string path = (argc > 2) ? argv[2] : "";
+    if (mode == "--fleet") {
+        if (!KeyCollection::get_fleet_keys(path.empty() ? FLEET_DUMP_PATH : path))
+            Common::draw_text(0x10, 0x040, RED, "No recorded consoles found to get keys from.");
+    } else {
+        KeyCollection Keys((mode == "--offline") ? (path.empty() ? OFFLINE_DUMP_PATH : path) : "");
+        Keys.get_keys();
+    }
+    Profiler::save(PROFILER_TRACE_PATH);
     Common::wait_to_exit();
 
     return 0;
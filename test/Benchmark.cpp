@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "TestData.hpp"
+
+#include "../source/Canvas.hpp"
+#include "../source/KeyScanner.hpp"
+#include "../source/KeySearch.hpp"
+#include "../source/Rsa2048.hpp"
+#include "../source/TicketBlockCache.hpp"
+#include "../source/TicketDecryptor.hpp"
+#include "../source/fatfs/ff.h"
+#include "../source/fatfs/diskio.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+// timed runs of each measurement after one untimed warmup, best and median are printed
+#define BENCH_REPETITIONS 7
+// bytes of memory the scanner and search run over
+#define BENCH_MEMORY_SIZE 0x1000000
+// keys searched for, random ones aren't in the memory so every byte is scanned
+#define BENCH_KEYS 32
+
+/*
+    host benchmark of the hot paths, built and run by make bench
+    every fixture comes from a fixed seed so numbers are comparable between builds on the same machine
+*/
+namespace Bench {
+    struct Case {
+        const char *name;
+        std::function<void()> run;
+    };
+
+    std::vector<Case> &get_cases() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    struct Register {
+        Register(const char *name, std::function<void()> run) { get_cases().push_back({name, run}); }
+    };
+
+    // time body, which handles units of unit each run, and print its rate, returns the median seconds of a run
+    double measure(const char *what, double units, const char *unit, const std::function<void()> &body) {
+        body();
+        std::vector<double> seconds;
+        for (size_t i = 0; i < BENCH_REPETITIONS; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(seconds.begin(), seconds.end());
+        printf("%-32s best %10.1f %s  median %10.1f %s\n", what,
+            units / seconds.front(), unit, units / seconds[BENCH_REPETITIONS / 2], unit);
+        return seconds[BENCH_REPETITIONS / 2];
+    }
+}
+
+#define BENCH(name) \
+    static void bench_##name(); \
+    static Bench::Register register_##name(#name, bench_##name); \
+    static void bench_##name()
+
+static std::vector<Key> make_keys(std::mt19937_64 &rng, bool low_entropy = false) {
+    std::vector<Key> keys;
+    for (size_t i = 0; i < BENCH_KEYS; i++) {
+        byte_vector bytes = low_entropy ? TestData::low_entropy_bytes(rng, 0x10) : TestData::random_bytes(rng, 0x10);
+        keys.push_back(TestData::make_key("key", bytes));
+    }
+    return keys;
+}
+
+static std::vector<Key *> pointers(std::vector<Key> &keys) {
+    std::vector<Key *> p;
+    for (auto &k : keys)
+        p.push_back(&k);
+    return p;
+}
+
+BENCH(key_scanner) {
+    std::mt19937_64 rng(0x5343414e);
+    std::vector<Key> keys = make_keys(rng);
+    byte_vector random = TestData::random_bytes(rng, BENCH_MEMORY_SIZE);
+    Bench::measure("key_scanner random", random.size() / 1e6, "MB/s", [&] {
+        KeyScanner scanner(pointers(keys));
+        scanner.scan(random.data(), random.size());
+    });
+
+    // keys with the same few byte values, so nearly every window passes the byte sum filter and is hashed
+    std::vector<Key> low_entropy_keys = make_keys(rng, true);
+    byte_vector low_entropy = TestData::low_entropy_bytes(rng, BENCH_MEMORY_SIZE);
+    Bench::measure("key_scanner low entropy", low_entropy.size() / 1e6, "MB/s", [&] {
+        KeyScanner scanner(pointers(low_entropy_keys));
+        scanner.scan(low_entropy.data(), low_entropy.size());
+    });
+}
+
+// KeyLocation::find_keys as it was before KeyScanner, a full XXHash64 and a map probe at every offset
+static void reference_find_keys(const byte_vector &data, std::vector<Key *> &keys) {
+    u8 temp_hash[0x20];
+    size_t key_indices_left = keys.size();
+    std::unordered_map<u64, size_t> hash_index;
+    for (size_t i = 0; i < keys.size(); i++)
+        hash_index[keys[i]->xx_hash] = i;
+
+    for (size_t i = 0; i < data.size() - 0x10; i++) {
+        u64 hash = XXHash64::hash(data.data() + i, 0x10, 0);
+        auto search = hash_index.find(hash);
+        if (search == hash_index.end())
+            continue;
+        Key *k = keys[search->second];
+        sha256CalculateHash(temp_hash, data.data() + i, k->length);
+        if (!std::equal(k->hash.begin(), k->hash.end(), temp_hash))
+            continue;
+        k->key.assign(data.begin() + i, data.begin() + i + k->length);
+        k->set_found();
+        if (--key_indices_left == 0)
+            return;
+        hash_index.erase(search);
+        i += k->length - 1;
+    }
+}
+
+BENCH(find_keys) {
+    std::mt19937_64 rng(0x46494e44);
+    std::vector<Key> keys = make_keys(rng);
+    // a few keys are in the buffer, so both also confirm matches, the rest keep the whole buffer scanned
+    std::vector<byte_vector> planted;
+    for (size_t i = 0; i < 4; i++) {
+        planted.push_back(TestData::random_bytes(rng, (i % 2) ? 0x20 : 0x10));
+        keys.push_back(TestData::make_key("planted", planted.back()));
+    }
+    char what[0x40];
+    // the sizes FS, SSL and ES segments come in
+    for (size_t size : {0x400000, 0x1000000}) {
+        byte_vector data = TestData::random_bytes(rng, size);
+        for (size_t i = 0; i < planted.size(); i++)
+            std::copy(planted[i].begin(), planted[i].end(), data.begin() + (i + 1) * (size / 5));
+
+        std::vector<Key> reference_keys = keys, scanner_keys = keys;
+        std::vector<Key *> p = pointers(reference_keys);
+        reference_find_keys(data, p);
+        KeyScanner check(pointers(scanner_keys));
+        check.scan(data.data(), data.size());
+        check.store();
+        for (size_t i = 0; i < keys.size(); i++) {
+            if ((reference_keys[i].found() != scanner_keys[i].found()) || (reference_keys[i].key != scanner_keys[i].key))
+                printf("find_keys: KeyScanner and the reference disagree on key %zu\n", i);
+        }
+
+        snprintf(what, sizeof(what), "find_keys reference %zu MiB", size >> 20);
+        Bench::measure(what, size / 1e6, "MB/s", [&] {
+            std::vector<Key> search_keys = keys;
+            std::vector<Key *> p = pointers(search_keys);
+            reference_find_keys(data, p);
+        });
+        snprintf(what, sizeof(what), "find_keys KeyScanner %zu MiB", size >> 20);
+        Bench::measure(what, size / 1e6, "MB/s", [&] {
+            KeyScanner scanner(pointers(keys));
+            scanner.scan(data.data(), data.size());
+        });
+    }
+}
+
+// SSL and ES keys used to be found with a find_key pass each, one pass for all of them has to win from the first extra key
+BENCH(batched_scan) {
+    std::mt19937_64 rng(0x42415443);
+    byte_vector data = TestData::random_bytes(rng, 0x400000);
+    std::vector<Key> keys;
+    for (size_t i = 0; i < 8; i++)
+        keys.push_back(TestData::make_key("key", TestData::random_bytes(rng, (i % 2) ? 0x20 : 0x10)));
+
+    char what[0x40];
+    for (size_t n = 1; n <= keys.size(); n++) {
+        std::vector<Key> batch(keys.begin(), keys.begin() + n);
+        snprintf(what, sizeof(what), "%zu keys, one pass", n);
+        double one_pass = Bench::measure(what, data.size() / 1e6, "MB/s", [&] {
+            KeyScanner scanner(pointers(batch));
+            scanner.scan(data.data(), data.size());
+        });
+        snprintf(what, sizeof(what), "%zu keys, find_key each", n);
+        double separate = Bench::measure(what, data.size() / 1e6, "MB/s", [&] {
+            for (auto &k : batch)
+                k.find_key(data);
+        });
+        printf("%zu keys: one pass takes %.2fx the time of separate passes\n", n, one_pass / separate);
+    }
+}
+
+BENCH(key_search) {
+    std::mt19937_64 rng(0x53524348);
+    std::vector<Key> keys = make_keys(rng);
+    byte_vector data = TestData::random_bytes(rng, BENCH_MEMORY_SIZE);
+
+    // a view is scanned in place by every worker, otherwise chunks are read into buffers first
+    for (bool has_view : {true, false}) {
+        TestData::BufferMemory memory(data, has_view);
+        Bench::measure(has_view ? "key_search mapped" : "key_search read", data.size() / 1e6, "MB/s", [&] {
+            std::vector<Key> search_keys = keys;
+            KeySearch search;
+            search.add(memory, pointers(search_keys));
+            search.run();
+        });
+    }
+}
+
+BENCH(key_aes) {
+    std::mt19937_64 rng(0x4b455941);
+    Key master_key(TestData::random_bytes(rng, 0x10), 0x10), source(TestData::random_bytes(rng, 0x10), 0x10),
+        kek_seed(TestData::random_bytes(rng, 0x10), 0x10), key_seed(TestData::random_bytes(rng, 0x10), 0x10);
+    byte_vector block = TestData::random_bytes(rng, 0x10);
+
+    const size_t count = 0x10000;
+    u8 dest[0x10];
+    // how Key decrypted before its round keys were cached, the schedule expanded again for every block
+    Bench::measure("aes_decrypt_ecb fresh schedule", count, "ops/s", [&] {
+        for (size_t i = 0; i < count; i++) {
+            Aes128Context con;
+            aes128ContextCreate(&con, master_key.key.data(), false);
+            aes128DecryptBlock(&con, dest, block.data());
+        }
+    });
+    Bench::measure("aes_decrypt_ecb cached", count, "ops/s", [&] {
+        for (size_t i = 0; i < count; i++)
+            master_key.aes_decrypt_ecb(block.data(), dest, sizeof(dest));
+    });
+    // three decryptions, two of them under keys that only exist for the call
+    Bench::measure("generate_kek", count, "ops/s", [&] {
+        for (size_t i = 0; i < count; i++)
+            source.generate_kek(master_key, kek_seed, key_seed);
+    });
+}
+
+BENCH(rsa2048) {
+    std::mt19937_64 rng(0x52534132);
+    byte_vector N = TestData::random_bytes(rng, 0x100);
+    N[0] |= 0x80;
+    N[0xff] |= 1;
+    byte_vector D = TestData::random_bytes(rng, 0x100);
+    byte_vector input = TestData::random_bytes(rng, 0x100);
+    input[0] &= 0x7f;
+    Rsa2048 rsa(N.data());
+
+    const size_t count = 64;
+    u8 dest[0x100];
+    Bench::measure("rsa2048 exp_mod", count, "ops/s", [&] {
+        for (size_t i = 0; i < count; i++)
+            rsa.exp_mod(input.data(), D.data(), D.size(), dest);
+    });
+}
+
+BENCH(oaep) {
+    std::mt19937_64 rng(0x4f414550);
+    const size_t count = 0x4000;
+    byte_vector blocks = TestData::random_bytes(rng, count * 0x100);
+
+    u8 db[0xdf];
+    Bench::measure("oaep_decode", count, "ops/s", [&] {
+        for (size_t i = 0; i < count; i++)
+            TicketDecryptor::oaep_decode(blocks.data() + i * 0x100, db);
+    });
+}
+
+BENCH(disk_cache) {
+    const size_t size = 0x2000000;
+    std::mt19937_64 rng(0x4449534b);
+    byte_vector data = TestData::random_bytes(rng, size);
+    storage_image = tmpfile();
+    fwrite(data.data(), 1, data.size(), storage_image);
+    disk_initialize(0);
+
+    // fatfs reads a cluster at a time walking a file, and single sectors for its tables
+    byte_vector buffer(0x4000);
+    const DWORD sectors = size / FF_MAX_SS;
+    const UINT cluster = buffer.size() / FF_MAX_SS;
+    Bench::measure("disk_cache clusters", size / 1e6, "MB/s", [&] {
+        for (DWORD sector = 0; sector < sectors; sector += cluster)
+            disk_read(0, buffer.data(), sector, cluster);
+    });
+    Bench::measure("disk_cache sectors", size / 1e6, "MB/s", [&] {
+        for (DWORD sector = 0; sector < sectors; sector++)
+            disk_read(0, buffer.data(), sector, 1);
+    });
+
+    fclose(storage_image);
+    storage_image = NULL;
+}
+
+BENCH(ticket_scan) {
+    // personalized ticket save with a block of tickets every 0x10 blocks, other save data in between
+    const size_t blocks = 0x400, records = TICKET_BLOCK_SIZE / TICKET_RECORD_SIZE;
+    std::mt19937_64 rng(0x5343544b);
+    byte_vector save = TestData::random_bytes(rng, blocks * TICKET_BLOCK_SIZE);
+    size_t tickets = 0;
+    for (size_t b = 0; b < blocks; b += 0x10) {
+        for (size_t r = 0; r < records; r++, tickets++) {
+            const u32 signature_type = 0x10004;
+            memcpy(save.data() + b * TICKET_BLOCK_SIZE + r * TICKET_RECORD_SIZE, &signature_type, sizeof(signature_type));
+        }
+    }
+
+    TestData::StorageImage storage(TestData::fat_image("save", {{"80000000000000e2", save}}));
+    FATFS fs;
+    FIL file;
+    if (f_mount(&fs, "", 1) || f_chdir("/save") || f_open(&file, "80000000000000e2", FA_READ | FA_OPEN_EXISTING)) {
+        printf("ticket_scan: save image didn't mount\n");
+        return;
+    }
+
+    // a first run, or a ticket missing from the cached blocks, reads the whole save
+    Bench::measure("read_tickets whole save", save.size() / 1e6, "MB/s", [&] {
+        TicketBlockCache cache;
+        cache.read_tickets(file, 1, [](const u8 *) { return false; });
+    });
+
+    // later runs read the cached blocks and stop once every ticket was handled
+    TicketBlockCache cache;
+    cache.read_tickets(file, 1, [](const u8 *) { return false; });
+    Bench::measure("read_tickets cached blocks", tickets, "tickets/s", [&] {
+        size_t handled = 0;
+        cache.read_tickets(file, 1, [&](const u8 *) { return ++handled == tickets; });
+    });
+
+    f_close(&file);
+    f_mount(NULL, "", 0);
+}
+
+BENCH(canvas) {
+    const u32 width = 1280, height = 720;
+    std::vector<u32> pixels(width * height);
+    Canvas canvas;
+    canvas.attach(pixels.data(), width, height, width);
+
+    const size_t frames = 64;
+    Bench::measure("canvas fill_rect", frames * pixels.size() * sizeof(u32) / 1e6, "MB/s", [&] {
+        for (size_t i = 0; i < frames; i++)
+            canvas.fill_rect(0, 0, width, height, 0xff000000 | static_cast<u32>(i));
+    });
+
+    // glyph-like coverage, mostly empty or full with antialiased edges
+    std::mt19937_64 rng(0x424c4e44);
+    const s32 glyph = 0x20;
+    byte_vector mask(glyph * glyph);
+    for (auto &m : mask) {
+        u64 r = rng() % 8;
+        m = (r < 4) ? 0 : (r < 6) ? 0xff : static_cast<u8>(rng());
+    }
+    const size_t glyphs = (width / glyph) * (height / glyph);
+    Bench::measure("canvas blend_mask", frames * glyphs * mask.size() / 1e6, "Mpixel/s", [&] {
+        for (size_t i = 0; i < frames; i++) {
+            for (u32 y = 0; y + glyph <= height; y += glyph) {
+                for (u32 x = 0; x + glyph <= width; x += glyph)
+                    canvas.blend_mask(mask.data(), glyph, glyph, glyph, x, y, 0xffffff00);
+            }
+        }
+    });
+}
+
+// run every benchmark, or only those named on the command line
+int main(int argc, char **argv) {
+    for (auto &c : Bench::get_cases()) {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; i++)
+            selected |= !strcmp(argv[i], c.name);
+        if (selected)
+            c.run();
+    }
+    return 0;
+}
\ No newline at end of file
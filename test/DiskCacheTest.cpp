@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/fatfs/ff.h"
+#include "../source/fatfs/diskio.h"
+
+#include <stdio.h>
+
+// lines of the cache in diskio.c
+#define LINE_SECTORS (0x10000 / FF_MAX_SS)
+
+// every byte tells where it came from
+static u8 image_byte(u64 offset) {
+    return static_cast<u8>((offset >> 9) * 31 + offset);
+}
+
+// image of 64.5 cache lines, so the last line is short
+struct ImageFixture {
+    ImageFixture() {
+        storage_image = tmpfile();
+        byte_vector data(size);
+        for (u64 i = 0; i < size; i++)
+            data[i] = image_byte(i);
+        fwrite(data.data(), 1, data.size(), storage_image);
+        disk_initialize(0);
+        disk_cache_get_stats(&hits, &misses, &readaheads, &reads);
+    }
+    ~ImageFixture() {
+        fclose(storage_image);
+        storage_image = NULL;
+    }
+
+    bool read(DWORD sector, UINT count) {
+        byte_vector buffer(count * FF_MAX_SS);
+        if (disk_read(0, buffer.data(), sector, count) != RES_OK)
+            return false;
+        for (u64 i = 0; i < buffer.size(); i++) {
+            if (buffer[i] != image_byte(static_cast<u64>(sector) * FF_MAX_SS + i))
+                return false;
+        }
+        return true;
+    }
+
+    // change of each counter since the last call
+    void deltas(DWORD &hit, DWORD &miss, DWORD &readahead, DWORD &read) {
+        DWORD h, m, ra, r;
+        disk_cache_get_stats(&h, &m, &ra, &r);
+        hit = h - hits;
+        miss = m - misses;
+        readahead = ra - readaheads;
+        read = r - reads;
+        hits = h, misses = m, readaheads = ra, reads = r;
+    }
+
+    const u64 size = 64 * 0x10000 + 0x8000;
+    const DWORD sectors = size / FF_MAX_SS;
+    DWORD hits, misses, readaheads, reads;
+};
+
+TEST(disk_cache_reads_match_image) {
+    ImageFixture f;
+    std::mt19937_64 rng(0x4449534b);
+
+    for (size_t i = 0; i < 200; i++) {
+        UINT count = 1 + rng() % (LINE_SECTORS + 8);
+        DWORD sector = rng() % (f.sectors - count + 1);
+        CHECK(f.read(sector, count));
+    }
+    // across a line boundary, the short last line and the very last sector
+    CHECK(f.read(LINE_SECTORS - 1, 2));
+    CHECK(f.read(64 * LINE_SECTORS, LINE_SECTORS / 2));
+    CHECK(f.read(f.sectors - 1, 1));
+
+    // nothing past the end
+    byte_vector buffer(2 * FF_MAX_SS);
+    CHECK(disk_read(0, buffer.data(), f.sectors - 1, 2) != RES_OK);
+    CHECK(disk_read(0, buffer.data(), f.sectors, 1) != RES_OK);
+}
+
+TEST(disk_cache_hits_and_readahead) {
+    ImageFixture f;
+    DWORD hit, miss, readahead, read;
+
+    CHECK(f.read(0, 1));
+    CHECK(f.read(1, 4));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((hit == 1) && (miss == 1) && (readahead == 0) && (read == 1));
+
+    // second miss in a row also fetches the line after it
+    CHECK(f.read(LINE_SECTORS, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((miss == 1) && (readahead == 1) && (read == 2));
+    CHECK(f.read(2 * LINE_SECTORS + 5, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((hit == 1) && (miss == 0) && (read == 0));
+
+    // whole lines bypass the cache
+    CHECK(f.read(10 * LINE_SECTORS, LINE_SECTORS));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((hit == 0) && (miss == 0) && (read == 1));
+}
+
+TEST(disk_cache_evicts_least_recently_used) {
+    ImageFixture f;
+    DWORD hit, miss, readahead, read;
+
+    // every third line so no miss follows the line before it, filling all 16 slots
+    for (DWORD line = 0; line < 48; line += 3)
+        CHECK(f.read(line * LINE_SECTORS, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((miss == 16) && (readahead == 0));
+
+    // line 0 is used again, so line 3 is the oldest when line 50 comes in
+    CHECK(f.read(0, 1));
+    CHECK(f.read(50 * LINE_SECTORS, 1));
+    CHECK(f.read(0, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK((hit == 2) && (miss == 1));
+
+    CHECK(f.read(6 * LINE_SECTORS, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK(hit == 1);
+    CHECK(f.read(3 * LINE_SECTORS, 1));
+    f.deltas(hit, miss, readahead, read);
+    CHECK(miss == 1);
+}
\ No newline at end of file
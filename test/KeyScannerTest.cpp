@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/KeyCollection.hpp"
+#include "../source/KeySearch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include <stdlib.h>
+
+using TestData::BufferMemory;
+
+// "name = hex" lines of a keys file, as written by save_keys
+static std::map<std::string, byte_vector> read_keys_file(const char *path) {
+    std::map<std::string, byte_vector> keys;
+    std::ifstream file(path);
+    for (std::string line; std::getline(file, line); ) {
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+            continue;
+        std::string name = line.substr(0, line.find_first_of(" =")), hex = line.substr(equals + 1);
+        hex.erase(std::remove_if(hex.begin(), hex.end(), [](char c) { return !isxdigit(static_cast<u8>(c)); }), hex.end());
+        byte_vector bytes(hex.size() / 2);
+        for (size_t i = 0; i < bytes.size(); i++)
+            bytes[i] = static_cast<u8>(strtoul(hex.substr(i * 2, 2).c_str(), nullptr, 16));
+        keys[name] = bytes;
+    }
+    return keys;
+}
+
+TEST(search_key_table) {
+    KeyCollection collection;
+    auto keys = collection.get_memory_search_keys();
+    REQUIRE(!keys.empty());
+
+    for (auto k : keys) {
+        CHECK(k->length >= SCAN_WINDOW);
+        CHECK(k->byte_sum <= SCAN_MAX_SUM);
+        CHECK(k->hash.size() == 0x20);
+        // KeyScanner keeps one slot per xxhash
+        for (auto other : keys)
+            CHECK((k == other) || (k->xx_hash != other->xx_hash));
+    }
+}
+
+/*
+    the table's xx_hash and byte_sum can only be checked against the key sources themselves,
+    which aren't distributable, so they're read from a keys file named by LOCKPICK_KEYS
+*/
+TEST(prefilter_constants) {
+    const char *path = getenv("LOCKPICK_KEYS");
+    if (path == nullptr) {
+        Test::skip("set LOCKPICK_KEYS to a prod.keys holding the key sources");
+        return;
+    }
+    auto sources = read_keys_file(path);
+
+    KeyCollection collection;
+    size_t checked = 0;
+    for (auto k : collection.get_memory_search_keys()) {
+        auto it = sources.find(k->name);
+        if (it == sources.end())
+            continue;
+        const byte_vector &bytes = it->second;
+        REQUIRE(bytes.size() == k->length);
+
+        Key expected = TestData::make_key(k->name, bytes);
+        if ((expected.hash != k->hash) || (expected.xx_hash != k->xx_hash) || (expected.byte_sum != k->byte_sum)) {
+            printf("    %s: xx_hash 0x%016lx byte_sum 0x%x\n", k->name.c_str(),
+                static_cast<unsigned long>(expected.xx_hash), expected.byte_sum);
+        }
+        CHECK(expected.hash == k->hash);
+        CHECK(expected.xx_hash == k->xx_hash);
+        CHECK(expected.byte_sum == k->byte_sum);
+        checked++;
+    }
+
+    if (checked == 0)
+        Test::skip("no key sources in LOCKPICK_KEYS");
+}
+
+// keys planted at random, next to chunk boundaries and at the very end, some twice
+static byte_vector make_memory(std::mt19937_64 &rng, bool low_entropy, std::vector<Key> &keys) {
+    size_t size = 3 * SEARCH_CHUNK_SIZE + rng() % SEARCH_CHUNK_SIZE;
+    byte_vector data = low_entropy ? TestData::low_entropy_bytes(rng, size) : TestData::random_bytes(rng, size);
+
+    std::vector<size_t> offsets = {
+        SEARCH_CHUNK_SIZE - 0x8,
+        2 * SEARCH_CHUNK_SIZE - 0x1f,
+        2 * SEARCH_CHUNK_SIZE,
+        size - 0x20
+    };
+    for (size_t i = 0; i < 8; i++)
+        offsets.push_back(rng() % (size - 0x20));
+
+    std::vector<byte_vector> planted;
+    for (size_t i = 0; i < offsets.size(); i++) {
+        // last two repeat earlier keys, only the first copy counts
+        byte_vector bytes = (i + 2 >= offsets.size()) ? planted[i % 3] : TestData::random_bytes(rng, (i & 1) ? 0x20 : 0x10);
+        if (std::any_of(offsets.begin(), offsets.begin() + i, [&](size_t o) { return (o < offsets[i] + 0x20) && (offsets[i] < o + 0x20); }))
+            continue;
+        std::copy(bytes.begin(), bytes.end(), data.begin() + offsets[i]);
+        if (i + 2 < offsets.size())
+            planted.push_back(bytes);
+    }
+
+    keys.clear();
+    for (size_t i = 0; i < planted.size(); i++)
+        keys.push_back(TestData::make_key("key_" + std::to_string(i), planted[i]));
+    // one key that isn't there
+    keys.push_back(TestData::make_key("missing", TestData::random_bytes(rng, 0x10)));
+    return data;
+}
+
+static std::vector<Key *> pointers(std::vector<Key> &keys) {
+    std::vector<Key *> p;
+    for (auto &k : keys)
+        p.push_back(&k);
+    return p;
+}
+
+TEST(chunked_search_matches_single_pass) {
+    std::mt19937_64 rng(0x4c6f636b7069636b);
+
+    for (size_t round = 0; round < 8; round++) {
+        std::vector<Key> keys;
+        byte_vector data = make_memory(rng, round & 1, keys);
+
+        KeyScanner single(pointers(keys));
+        single.scan(data.data(), data.size());
+        auto expected = single.get_matches();
+        std::sort(expected.begin(), expected.end());
+        CHECK(expected.size() == keys.size() - 1);
+
+        // mapped and read sources take different paths through KeySearch::work
+        for (bool has_view : {true, false}) {
+            std::vector<Key> search_keys = keys;
+            BufferMemory memory(data, has_view);
+            KeySearch search;
+            search.add(memory, pointers(search_keys));
+            search.run();
+
+            std::vector<std::pair<Key *, size_t>> found;
+            for (auto &m : search.get_matches()) {
+                // compare by position in keys since each search has its own copies
+                Key *k = &keys[m.key - search_keys.data()];
+                found.push_back({k, m.offset});
+                CHECK(m.key->found());
+                CHECK(std::equal(m.key->key.begin(), m.key->key.end(), data.begin() + m.offset));
+            }
+            std::sort(found.begin(), found.end());
+            CHECK(found == expected);
+            CHECK(!search_keys.back().found());
+        }
+    }
+}
+
+// fails reads of one chunk a given number of times before serving them
+class FlakyMemory : public BufferMemory {
+public:
+    FlakyMemory(const byte_vector &data, size_t chunk, size_t failures) : BufferMemory(data, false), chunk(chunk), failures(failures) {}
+
+    bool read(u8 *dest, size_t offset, size_t length) override {
+        if ((offset == chunk * SEARCH_CHUNK_SIZE) && (failures > 0)) {
+            failures--;
+            return false;
+        }
+        return BufferMemory::read(dest, offset, length);
+    }
+
+private:
+    size_t chunk, failures;
+};
+
+TEST(failed_chunk_reads) {
+    std::mt19937_64 rng(0x6661696c);
+    byte_vector data = TestData::random_bytes(rng, 3 * SEARCH_CHUNK_SIZE);
+    byte_vector bytes = TestData::random_bytes(rng, 0x20);
+    std::copy(bytes.begin(), bytes.end(), data.begin() + SEARCH_CHUNK_SIZE + 0x100);
+
+    // one failure is retried away
+    {
+        Key key = TestData::make_key("key", bytes);
+        FlakyMemory memory(data, 1, SEARCH_READ_ATTEMPTS - 1);
+        KeySearch search;
+        search.add(memory, {&key});
+        search.run();
+        CHECK(key.found());
+        CHECK(search.get_chunks_failed() == 0);
+    }
+
+    // a chunk that never reads is reported
+    {
+        Key key = TestData::make_key("key", bytes);
+        FlakyMemory memory(data, 1, SIZE_MAX);
+        KeySearch search;
+        search.add(memory, {&key});
+        search.run();
+        CHECK(!key.found());
+        CHECK(search.get_chunks_failed() == 1);
+        CHECK(search.get_bytes_read() < data.size());
+    }
+}
\ No newline at end of file
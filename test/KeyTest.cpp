@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/Key.hpp"
+
+#include <switch.h>
+
+// ECB decryption as Key did it before round keys were cached, a fresh schedule every call
+static byte_vector reference_ecb(const byte_vector &key, const byte_vector &data) {
+    byte_vector dest(data.size());
+    Aes128Context con;
+    aes128ContextCreate(&con, key.data(), false);
+    for (size_t offset = 0; offset < data.size(); offset += 0x10)
+        aes128DecryptBlock(&con, dest.data() + offset, data.data() + offset);
+    return dest;
+}
+
+// the former generate_kek chain of three temporary Keys
+static byte_vector reference_kek(const byte_vector &source, const byte_vector &master_key, const byte_vector &kek_seed, const byte_vector *key_seed) {
+    byte_vector kek = reference_ecb(master_key, kek_seed);
+    byte_vector src_kek = reference_ecb(kek, source);
+    return key_seed ? reference_ecb(src_kek, *key_seed) : src_kek;
+}
+
+TEST(aes_decrypt_ecb_known_answer) {
+    // FIPS-197 appendix C.1
+    byte_vector key(0x10), plain(0x10);
+    for (u8 i = 0; i < 0x10; i++) {
+        key[i] = i;
+        plain[i] = i * 0x11;
+    }
+    const byte_vector cipher = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a};
+
+    Key k(key, 0x10);
+    CHECK(k.aes_decrypt_ecb(cipher) == plain);
+    // the second call goes through the cached round keys
+    u8 dest[0x10];
+    k.aes_decrypt_ecb(cipher.data(), dest, sizeof(dest));
+    CHECK(std::equal(plain.begin(), plain.end(), dest));
+}
+
+TEST(aes_decrypt_ecb_reassigned_key) {
+    std::mt19937_64 rng(0x4145535f);
+    byte_vector first = TestData::random_bytes(rng, 0x10);
+    byte_vector second = TestData::random_bytes(rng, 0x10);
+    byte_vector data = TestData::random_bytes(rng, 0x40);
+
+    Key k(first, 0x10);
+    CHECK(k.aes_decrypt_ecb(data) == reference_ecb(first, data));
+
+    // derivation assigns key after the Key was already used
+    k.key = second;
+    CHECK(k.aes_decrypt_ecb(data) == reference_ecb(second, data));
+
+    // a change of one byte in place must expand the round keys again
+    k.key[0xf] ^= 1;
+    byte_vector changed = second;
+    changed[0xf] ^= 1;
+    CHECK(k.aes_decrypt_ecb(data) == reference_ecb(changed, data));
+
+    k.key = first;
+    CHECK(k.aes_decrypt_ecb(data) == reference_ecb(first, data));
+
+    Key missing("missing", 0x10);
+    CHECK(missing.aes_decrypt_ecb(data) == byte_vector(data.size(), 0));
+}
+
+TEST(generate_kek_matches_key_chain) {
+    std::mt19937_64 rng(0x4b454b5f);
+    for (size_t round = 0; round < 16; round++) {
+        byte_vector source = TestData::random_bytes(rng, 0x10);
+        byte_vector master = TestData::random_bytes(rng, 0x10);
+        byte_vector kek_seed = TestData::random_bytes(rng, 0x10);
+        byte_vector key_seed = TestData::random_bytes(rng, 0x10);
+
+        Key source_key(source, 0x10), master_key(master, 0x10), kek_seed_key(kek_seed, 0x10), key_seed_key(key_seed, 0x10);
+        CHECK(source_key.generate_kek(master_key, kek_seed_key, key_seed_key) == reference_kek(source, master, kek_seed, &key_seed));
+
+        // without a key seed the source kek itself is returned
+        Key no_key_seed("key_seed", 0x10);
+        CHECK(source_key.generate_kek(master_key, kek_seed_key, no_key_seed) == reference_kek(source, master, kek_seed, nullptr));
+
+        // master keys are reused across generations with their cached round keys
+        master_key.key = TestData::random_bytes(rng, 0x10);
+        CHECK(source_key.generate_kek(master_key, kek_seed_key, key_seed_key) == reference_kek(source, master_key.key, kek_seed, &key_seed));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/KeySearch.hpp"
+#include "../source/MemorySource.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+
+struct DumpFixture {
+    DumpFixture() {
+        snprintf(path, sizeof(path), "/tmp/lockpick_dump_%d.bin", getpid());
+        std::mt19937_64 rng(0x46494c45);
+        data = TestData::random_bytes(rng, 0x30123);
+        bytes = TestData::random_bytes(rng, 0x10);
+        std::copy(bytes.begin(), bytes.end(), data.begin() + 0x2f000);
+
+        FILE *out = fopen(path, "wb");
+        fwrite(data.data(), 1, data.size(), out);
+        fclose(out);
+    }
+    ~DumpFixture() { remove(path); }
+
+    char path[64];
+    byte_vector data, bytes;
+};
+
+TEST(file_memory_maps_dump) {
+    DumpFixture f;
+    FileMemory memory(f.path);
+    REQUIRE(memory.size() == f.data.size());
+
+    // host builds read dumps through mmap, the console falls back to fread
+    REQUIRE(memory.view() != nullptr);
+    CHECK(std::equal(f.data.begin(), f.data.end(), memory.view()));
+
+    byte_vector chunk(0x1000);
+    CHECK(memory.read(chunk.data(), 0x12345, chunk.size()));
+    CHECK(std::equal(chunk.begin(), chunk.end(), f.data.begin() + 0x12345));
+    CHECK(memory.read(chunk.data(), f.data.size() - chunk.size(), chunk.size()));
+    CHECK(!memory.read(chunk.data(), f.data.size() - chunk.size() + 1, chunk.size()));
+}
+
+TEST(file_memory_missing_file) {
+    FileMemory memory("/tmp/lockpick_no_such_dump.bin");
+    byte_vector chunk(0x10);
+    CHECK(memory.size() == 0);
+    CHECK(memory.view() == nullptr);
+    CHECK(!memory.read(chunk.data(), 0, chunk.size()));
+}
+
+TEST(file_memory_key_search) {
+    DumpFixture f;
+    FileMemory memory(f.path);
+    Key key = TestData::make_key("key", f.bytes);
+    KeySearch search;
+    search.add(memory, {&key});
+    search.run();
+
+    REQUIRE(search.get_matches().size() == 1);
+    CHECK(search.get_matches()[0].offset == 0x2f000);
+    CHECK(key.found());
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "../source/KeyCollection.hpp"
+
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+    offline and fleet modes of Lockpick on a computer, recorded consoles are read the same way the
+    switch reads them from the sd card and prod.keys and title.keys are written into their directories
+*/
+
+// lines of a keyfile, 0 if it wasn't written
+static size_t count_lines(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL)
+        return 0;
+    size_t lines = 0;
+    for (int c = fgetc(file); c != EOF; c = fgetc(file))
+        lines += (c == '\n');
+    fclose(file);
+    return lines;
+}
+
+// one capture directory per line, relative ones are under the manifest's directory, '#' starts a comment
+static bool read_manifest(const std::string &path, std::vector<std::string> &consoles) {
+    FILE *manifest = fopen(path.c_str(), "r");
+    if (manifest == NULL) {
+        fprintf(stderr, "can't open %s\n", path.c_str());
+        return false;
+    }
+    std::filesystem::path base = std::filesystem::path(path).parent_path();
+    char line[0x400];
+    bool valid = true;
+    while (fgets(line, sizeof(line), manifest)) {
+        std::string entry(line);
+        entry = entry.substr(0, entry.find('#'));
+        size_t first = entry.find_first_not_of(" \t\r\n"), last = entry.find_last_not_of(" \t\r\n");
+        if (first == std::string::npos)
+            continue;
+        std::string console = (base / entry.substr(first, last - first + 1)).string();
+        if (!std::filesystem::is_directory(console)) {
+            fprintf(stderr, "%s is not a directory\n", console.c_str());
+            valid = false;
+        }
+        consoles.push_back(console);
+    }
+    fclose(manifest);
+    return valid;
+}
+
+int main(int argc, char **argv) {
+    std::string mode = (argc > 1) ? argv[1] : "";
+    std::vector<std::string> consoles;
+
+    if ((mode == "--fleet") && ((argc == 3) || (argc == 4))) {
+        size_t threads = (argc == 4) ? strtoul(argv[3], NULL, 0) : std::thread::hardware_concurrency();
+        if (!read_manifest(argv[2], consoles))
+            return 1;
+        if (!KeyCollection::get_fleet_keys(consoles, (threads != 0) ? threads : 1)) {
+            fprintf(stderr, "no consoles listed in %s\n", argv[2]);
+            return 1;
+        }
+    } else if ((argc == 2) && (mode.compare(0, 2, "--") != 0)) {
+        consoles.push_back(mode);
+        if (!std::filesystem::is_directory(mode)) {
+            fprintf(stderr, "%s is not a directory\n", mode.c_str());
+            return 1;
+        }
+        KeyCollection(mode).get_keys();
+    } else {
+        fprintf(stderr, "usage: %s <dump directory>\n", argv[0]);
+        fprintf(stderr, "       %s --fleet <manifest> [consoles at once]\n", argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (auto &console : consoles) {
+        size_t keys = count_lines(console + "/prod.keys"), titlekeys = count_lines(console + "/title.keys");
+        printf("%s: %lu keys, %lu titlekeys\n", console.c_str(), keys, titlekeys);
+        if (keys == 0)
+            status = 1;
+    }
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define OPENSSL_API_COMPAT 0x10100000L
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/KeyCollection.hpp"
+#include "../source/KeyLocation.hpp"
+#include "../source/TicketBlockCache.hpp"
+
+#include <filesystem>
+#include <map>
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+// sources KeyCollection holds as constants, the synthetic console's keys are derived from them
+static const byte_vector keyblob_key_sources[KNOWN_KEYBLOBS] = {
+    {0xDF, 0x20, 0x6F, 0x59, 0x44, 0x54, 0xEF, 0xDC, 0x70, 0x74, 0x48, 0x3B, 0x0D, 0xED, 0x9F, 0xD3},
+    {0x0C, 0x25, 0x61, 0x5D, 0x68, 0x4C, 0xEB, 0x42, 0x1C, 0x23, 0x79, 0xEA, 0x82, 0x25, 0x12, 0xAC},
+    {0x33, 0x76, 0x85, 0xEE, 0x88, 0x4A, 0xAE, 0x0A, 0xC2, 0x8A, 0xFD, 0x7D, 0x63, 0xC0, 0x43, 0x3B},
+    {0x2D, 0x1F, 0x48, 0x80, 0xED, 0xEC, 0xED, 0x3E, 0x3C, 0xF2, 0x48, 0xB5, 0x65, 0x7D, 0xF7, 0xBE},
+    {0xBB, 0x5A, 0x01, 0xF9, 0x88, 0xAF, 0xF5, 0xFC, 0x6C, 0xFF, 0x07, 0x9E, 0x13, 0x3C, 0x39, 0x80},
+    {0xD8, 0xCC, 0xE1, 0x26, 0x6A, 0x35, 0x3F, 0xCC, 0x20, 0xF3, 0x2D, 0x3B, 0x51, 0x7D, 0xE9, 0xC0}};
+static const byte_vector keyblob_mac_key_source = {
+    0x59, 0xC7, 0xFB, 0x6F, 0xBE, 0x9B, 0xBE, 0x87, 0x65, 0x6B, 0x15, 0xC0, 0x53, 0x73, 0x36, 0xA5};
+static const byte_vector master_key_source = {
+    0xD8, 0xA2, 0x41, 0x0A, 0xC6, 0xC5, 0x90, 0x01, 0xC6, 0x1D, 0x6A, 0x26, 0x7C, 0x51, 0x3F, 0x3C};
+static const byte_vector titlekek_source = {
+    0x1E, 0xDC, 0x7B, 0x3B, 0x60, 0xE6, 0xB4, 0xD8, 0x78, 0xB8, 0x17, 0x15, 0x98, 0x5E, 0x62, 0x9B};
+
+static byte_vector decrypt_ecb(const byte_vector &key, const byte_vector &data) {
+    byte_vector dest(data.size());
+    Aes128Context con;
+    aes128ContextCreate(&con, key.data(), false);
+    for (size_t offset = 0; offset < data.size(); offset += 0x10)
+        aes128DecryptBlock(&con, dest.data() + offset, data.data() + offset);
+    return dest;
+}
+
+static std::string hex(const byte_vector &bytes) {
+    std::string str;
+    char digits[3];
+    for (auto b : bytes) {
+        snprintf(digits, sizeof(digits), "%02x", b);
+        str += digits;
+    }
+    return str;
+}
+
+// a recorded console laid out as offline mode expects, with the keys it should give
+struct ConsoleDump {
+    ConsoleDump(u64 seed = 0x4f46464c) {
+        snprintf(path, sizeof(path), "/tmp/lockpick_console_%d_%lx", getpid(), seed);
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directory(path);
+        std::mt19937_64 rng(seed);
+
+        // Hekate dumps of the fuses and TSEC
+        byte_vector sbk = TestData::random_bytes(rng, 0x10), tsec = TestData::random_bytes(rng, 0x10);
+        byte_vector fuses(0x300, 0), tsec_keys(0x20, 0);
+        std::copy(sbk.begin(), sbk.end(), fuses.begin() + 0xa4);
+        std::copy(tsec.begin(), tsec.end(), tsec_keys.begin());
+        write("fuses.bin", fuses);
+        write("tsec_keys.bin", tsec_keys);
+
+        // keyblobs carry the master keks, encrypted and signed with keys from sbk and tsec
+        byte_vector boot0(KEYBLOB_OFFSET + 0x200 * KNOWN_KEYBLOBS, 0);
+        for (size_t i = 0; i < KNOWN_KEYBLOBS; i++) {
+            byte_vector keyblob_key = decrypt_ecb(sbk, decrypt_ecb(tsec, keyblob_key_sources[i]));
+            byte_vector keyblob_mac_key = decrypt_ecb(keyblob_key, keyblob_mac_key_source);
+            byte_vector keyblob = TestData::random_bytes(rng, 0x90), ctr = TestData::random_bytes(rng, 0x10);
+
+            u8 *encrypted = boot0.data() + KEYBLOB_OFFSET + 0x200 * i;
+            std::copy(ctr.begin(), ctr.end(), encrypted + 0x10);
+            Aes128CtrContext con;
+            aes128CtrContextCreate(&con, keyblob_key.data(), ctr.data());
+            aes128CtrCrypt(&con, encrypted + 0x20, keyblob.data(), keyblob.size());
+            cmacAes128CalculateMac(encrypted, keyblob_mac_key.data(), encrypted + 0x10, 0xa0);
+
+            byte_vector master_kek(keyblob.begin(), keyblob.begin() + 0x10);
+            master_key.push_back(decrypt_ecb(master_kek, master_key_source));
+            package1_key.push_back(byte_vector(keyblob.begin() + 0x80, keyblob.end()));
+        }
+        write("BOOT0.bin", boot0);
+
+        // sd seed sits at the start of a block of the system save, after the vector in "private"
+        byte_vector seed_vector = TestData::random_bytes(rng, 0x10), save = TestData::random_bytes(rng, 0x10000);
+        sd_seed = TestData::random_bytes(rng, 0x10);
+        std::copy(seed_vector.begin(), seed_vector.end(), save.begin() + 0x8000);
+        std::copy(sd_seed.begin(), sd_seed.end(), save.begin() + 0x8010);
+        write("private", seed_vector);
+
+        // eticket keypair of PRODINFO, encrypted with eticket_rsa_kek from a keyfile brought along
+        byte_vector eticket_rsa_kek = TestData::random_bytes(rng, 0x10), eticket_ctr = TestData::random_bytes(rng, 0x10);
+        byte_vector keypair(0x230, 0), eticket_device_key(0x240);
+        generate_keypair(keypair);
+        std::copy(eticket_ctr.begin(), eticket_ctr.end(), eticket_device_key.begin());
+        Aes128CtrContext con;
+        aes128CtrContextCreate(&con, eticket_rsa_kek.data(), eticket_ctr.data());
+        aes128CtrCrypt(&con, eticket_device_key.data() + 0x10, keypair.data(), keypair.size());
+        write(ETICKET_DEVICE_KEY_DUMP, eticket_device_key);
+        std::string keyfile = "eticket_rsa_kek = " + hex(eticket_rsa_kek) + "\n";
+        write("prod.keys", byte_vector(keyfile.begin(), keyfile.end()));
+
+        // common tickets hold their titlekey as is, personalized ones encrypted to the keypair
+        byte_vector common_save(0x10 * TICKET_BLOCK_SIZE, 0), personalized_save(0x10 * TICKET_BLOCK_SIZE, 0);
+        for (size_t i = 0; i < 6; i++) {
+            byte_vector rights_id = TestData::random_bytes(rng, 0x10), titlekey = TestData::random_bytes(rng, 0x10);
+            titlekeys[hex(rights_id)] = hex(titlekey);
+            if (i < 3) {
+                put_ticket(common_save, 2 + i / 2, i % 2, rights_id, titlekey);
+            } else {
+                byte_vector block = encrypt_titlekey(keypair, titlekey);
+                // a damaged older copy comes first and mustn't keep the good one from being used
+                if (i == 3) {
+                    byte_vector damaged = block;
+                    damaged[0x80] ^= 1;
+                    put_ticket(personalized_save, 1, 0, rights_id, damaged);
+                }
+                put_ticket(personalized_save, 5, i - 3, rights_id, block);
+            }
+        }
+        write("SYSTEM.bin", TestData::fat_image("save", {
+            {"8000000000000043", save}, {"80000000000000e1", common_save}, {"80000000000000e2", personalized_save}}));
+
+        // process memory without any of the key sources in it
+        for (auto name : {"FS.bin", "SSL.bin", "ES.bin"})
+            write(name, TestData::random_bytes(rng, 0x40000));
+    }
+    ~ConsoleDump() { std::filesystem::remove_all(path); }
+
+    void write(const char *name, const byte_vector &data) {
+        FILE *out = fopen((std::string(path) + "/" + name).c_str(), "wb");
+        fwrite(data.data(), 1, data.size(), out);
+        fclose(out);
+    }
+
+    // D, N and E of a new RSA-2048 keypair in the layout of the decrypted eticket device key
+    static void generate_keypair(byte_vector &keypair) {
+        RSA *key = RSA_new();
+        BIGNUM *e = BN_new();
+        BN_set_word(e, 65537);
+        RSA_generate_key_ex(key, 2048, e, nullptr);
+        const BIGNUM *n, *d;
+        RSA_get0_key(key, &n, nullptr, &d);
+        BN_bn2binpad(d, keypair.data(), 0x100);
+        BN_bn2binpad(n, keypair.data() + 0x100, 0x100);
+        BN_bn2binpad(e, keypair.data() + 0x200, 4);
+        BN_free(e);
+        RSA_free(key);
+    }
+
+    // titlekey block of a personalized ticket, OAEP padded and encrypted to the public half of keypair
+    static byte_vector encrypt_titlekey(const byte_vector &keypair, const byte_vector &titlekey) {
+        byte_vector M(0x100), block(0x100);
+        RSA_padding_add_PKCS1_OAEP_mgf1(M.data(), M.size(), titlekey.data(), titlekey.size(), nullptr, 0, EVP_sha256(), EVP_sha256());
+        splUserExpMod(M.data(), keypair.data() + 0x100, keypair.data() + 0x200, 4, block.data());
+        return block;
+    }
+
+    static void put_ticket(byte_vector &save, size_t block, size_t record, const byte_vector &rights_id, const byte_vector &titlekey_block) {
+        u8 *r = save.data() + block * TICKET_BLOCK_SIZE + record * TICKET_RECORD_SIZE;
+        const u32 signature_type = 0x10004;
+        memcpy(r, &signature_type, sizeof(signature_type));
+        std::copy(titlekey_block.begin(), titlekey_block.end(), r + 0x180);
+        std::copy(rights_id.begin(), rights_id.end(), r + 0x2a0);
+    }
+
+    // name to hex key of each "name = key" line of a keyfile in the dump
+    std::map<std::string, std::string> read_keys(const char *file_name) {
+        std::map<std::string, std::string> keys;
+        FILE *in = fopen((std::string(path) + "/" + file_name).c_str(), "r");
+        if (in == NULL)
+            return keys;
+        char name[0x80], key[0x200];
+        while (fscanf(in, "%127s = %511s", name, key) == 2)
+            keys[name] = key;
+        fclose(in);
+        return keys;
+    }
+
+    // master keys of every console are checked the same way
+    void check_console_keys() {
+        std::map<std::string, std::string> keys = read_keys("prod.keys");
+        REQUIRE(!keys.empty());
+        char name[0x20];
+        for (size_t i = 0; i < KNOWN_KEYBLOBS; i++) {
+            snprintf(name, sizeof(name), "master_key_%02lx", i);
+            CHECK(keys[name] == hex(master_key[i]));
+            snprintf(name, sizeof(name), "package1_key_%02lx", i);
+            CHECK(keys[name] == hex(package1_key[i]));
+            snprintf(name, sizeof(name), "titlekek_%02lx", i);
+            CHECK(keys[name] == hex(decrypt_ecb(master_key[i], titlekek_source)));
+        }
+        CHECK(keys["sd_seed"] == hex(sd_seed));
+    }
+
+    char path[64];
+    std::vector<byte_vector> master_key, package1_key;
+    byte_vector sd_seed;
+    // hex rights id to hex titlekey of every ticket
+    std::map<std::string, std::string> titlekeys;
+};
+
+TEST(offline_dump_derives_console_keys) {
+    ConsoleDump dump;
+    KeyCollection(dump.path).get_keys();
+    dump.check_console_keys();
+
+    // bis keys belong to the console running this, and the header key needs spl
+    std::map<std::string, std::string> keys = dump.read_keys("prod.keys");
+    CHECK(keys.count("bis_key_00") == 0);
+    CHECK(keys.count("header_key") == 0);
+}
+
+TEST(offline_dump_decrypts_titlekeys) {
+    ConsoleDump dump;
+    KeyCollection(dump.path).get_keys();
+
+    // the eticket_rsa_kek brought along is saved with the derived keys
+    CHECK(dump.read_keys("prod.keys").count("eticket_rsa_kek") == 1);
+    CHECK(dump.read_keys("title.keys") == dump.titlekeys);
+}
+
+// consoles of a fleet run side by side and still each get their own keys
+TEST(fleet_consoles_in_parallel) {
+    std::vector<std::unique_ptr<ConsoleDump>> dumps;
+    std::vector<std::string> consoles;
+    for (u64 seed = 1; seed <= 4; seed++) {
+        dumps.emplace_back(new ConsoleDump(seed));
+        consoles.push_back(dumps.back()->path);
+    }
+    REQUIRE(KeyCollection::get_fleet_keys(consoles, 3));
+    for (auto &dump : dumps) {
+        dump->check_console_keys();
+        CHECK(dump->read_keys("title.keys") == dump->titlekeys);
+    }
+    CHECK(!KeyCollection::get_fleet_keys(std::vector<std::string>(), 3));
+}
\ No newline at end of file
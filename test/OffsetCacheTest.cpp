@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/OffsetCache.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+
+// BufferMemory with a build id, OffsetCache only keeps offsets of known builds
+class ModuleMemory : public TestData::BufferMemory {
+public:
+    ModuleMemory(const byte_vector &data) : BufferMemory(data, false) {}
+    std::vector<u8> get_module_id() const override { return std::vector<u8>(MODULE_ID_SIZE, 0x5a); }
+};
+
+struct CacheFixture {
+    CacheFixture() {
+        snprintf(path, sizeof(path), "/tmp/lockpick_offsets_%d.bin", getpid());
+        std::mt19937_64 rng(0x4c504f43);
+        data = TestData::random_bytes(rng, 0x4000);
+        bytes = TestData::random_bytes(rng, 0x10);
+        std::copy(bytes.begin(), bytes.end(), data.begin() + 0x1230);
+    }
+    ~CacheFixture() { remove(path); }
+
+    // key found at its cached offset by a fresh cache
+    bool cached(MemorySource &memory) {
+        Key key = TestData::make_key("key", bytes);
+        OffsetCache cache(path);
+        cache.load();
+        return (cache.find_keys(memory, {&key}) == 1) && key.found();
+    }
+
+    char path[64];
+    byte_vector data, bytes;
+};
+
+TEST(offset_cache_round_trip) {
+    CacheFixture f;
+    ModuleMemory memory(f.data);
+    CHECK(!f.cached(memory));
+
+    Key key = TestData::make_key("key", f.bytes);
+    OffsetCache cache(f.path);
+    cache.load();
+    cache.set_offset(memory, key, 0x1230);
+    cache.save();
+    CHECK(f.cached(memory));
+}
+
+TEST(offset_cache_rejects_bad_counts) {
+    CacheFixture f;
+    ModuleMemory memory(f.data);
+    Key key = TestData::make_key("key", f.bytes);
+    {
+        OffsetCache cache(f.path);
+        cache.load();
+        cache.set_offset(memory, key, 0x1230);
+        cache.save();
+    }
+
+    FILE *file = fopen(f.path, "rb");
+    REQUIRE(file != nullptr);
+    byte_vector good(0x100);
+    good.resize(fread(good.data(), 1, good.size(), file));
+    fclose(file);
+    REQUIRE(good.size() > 0x10);
+
+    auto write = [&](const byte_vector &contents) {
+        FILE *out = fopen(f.path, "wb");
+        fwrite(contents.data(), 1, contents.size(), out);
+        fclose(out);
+    };
+
+    // entry_count is the third u32 of the header
+    byte_vector huge = good;
+    huge[0xb] = 0xff;
+    write(huge);
+    CHECK(!f.cached(memory));
+
+    byte_vector extra = good;
+    extra[0x8]++;
+    write(extra);
+    CHECK(!f.cached(memory));
+
+    byte_vector truncated(good.begin(), good.end() - 1);
+    write(truncated);
+    CHECK(!f.cached(memory));
+
+    write(good);
+    CHECK(f.cached(memory));
+}
\ No newline at end of file
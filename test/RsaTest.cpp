@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define OPENSSL_API_COMPAT 0x10100000L
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/Rsa2048.hpp"
+
+#include <openssl/bn.h>
+#include <openssl/rsa.h>
+
+#include <switch.h>
+
+// random odd 2048-bit modulus with the top bit set
+static byte_vector random_modulus(std::mt19937_64 &rng) {
+    byte_vector N = TestData::random_bytes(rng, 0x100);
+    N[0] |= 0x80;
+    N[0xff] |= 1;
+    return N;
+}
+
+// checks Rsa2048 against splUserExpMod, which the host build does with OpenSSL BIGNUMs
+static bool matches_reference(const Rsa2048 &rsa, const byte_vector &N, const byte_vector &input, const byte_vector &exp) {
+    u8 expected[0x100], result[0x100];
+    if (R_FAILED(splUserExpMod(input.data(), N.data(), exp.data(), exp.size(), expected)))
+        return false;
+    rsa.exp_mod(input.data(), exp.data(), exp.size(), result);
+    return std::equal(result, result + 0x100, expected);
+}
+
+TEST(rsa2048_random_vectors) {
+    std::mt19937_64 rng(0x52534132);
+
+    for (size_t round = 0; round < 16; round++) {
+        byte_vector N = random_modulus(rng);
+        Rsa2048 rsa(N.data());
+
+        byte_vector input = TestData::random_bytes(rng, 0x100);
+        input[0] &= 0x7f;
+        // full size private exponent, short public ones and one with leading zero bytes
+        for (size_t exp_size : {0x100, 0x3, 0x1}) {
+            byte_vector exp = TestData::random_bytes(rng, exp_size);
+            CHECK(matches_reference(rsa, N, input, exp));
+        }
+        byte_vector padded_exp = TestData::random_bytes(rng, 0x100);
+        std::fill(padded_exp.begin(), padded_exp.begin() + 0x80, 0);
+        CHECK(matches_reference(rsa, N, input, padded_exp));
+    }
+}
+
+TEST(rsa2048_edge_vectors) {
+    std::mt19937_64 rng(0x45444745);
+    byte_vector N = random_modulus(rng);
+    Rsa2048 rsa(N.data());
+    byte_vector exp = TestData::random_bytes(rng, 0x100);
+
+    byte_vector zero(0x100, 0), one(0x100, 0), n_minus_one = N;
+    one[0xff] = 1;
+    n_minus_one[0xff] &= 0xfe;
+    for (auto &input : {zero, one, n_minus_one})
+        CHECK(matches_reference(rsa, N, input, exp));
+
+    // x^1 = x and x^0 = 1
+    byte_vector input = TestData::random_bytes(rng, 0x100);
+    input[0] &= 0x7f;
+    u8 result[0x100];
+    u8 exp_one = 1, exp_zero = 0;
+    rsa.exp_mod(input.data(), &exp_one, 1, result);
+    CHECK(std::equal(result, result + 0x100, input.begin()));
+    rsa.exp_mod(input.data(), &exp_zero, 1, result);
+    CHECK(std::equal(result, result + 0x100, one.begin()));
+}
+
+// real keypair, private exponentiation undoes the public one like in test_key_pair
+TEST(rsa2048_keypair_round_trip) {
+    RSA *key = RSA_new();
+    BIGNUM *e = BN_new();
+    BN_set_word(e, 65537);
+    REQUIRE(RSA_generate_key_ex(key, 2048, e, nullptr) == 1);
+
+    const BIGNUM *n, *d;
+    RSA_get0_key(key, &n, nullptr, &d);
+    byte_vector N(0x100), D(0x100);
+    BN_bn2binpad(n, N.data(), 0x100);
+    BN_bn2binpad(d, D.data(), 0x100);
+    const u8 E[4] = {0, 1, 0, 1};
+
+    Rsa2048 rsa(N.data());
+    std::mt19937_64 rng(0x4b455950);
+    for (size_t i = 0; i < 4; i++) {
+        byte_vector message = TestData::random_bytes(rng, 0x100);
+        message[0] = 0;
+        u8 encrypted[0x100], decrypted[0x100];
+        rsa.exp_mod(message.data(), E, sizeof(E), encrypted);
+        rsa.exp_mod(encrypted, D.data(), D.size(), decrypted);
+        CHECK(std::equal(decrypted, decrypted + 0x100, message.begin()));
+    }
+
+    BN_free(e);
+    RSA_free(key);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+/*
+    host tests register themselves before main and are run by TestMain.cpp
+    builds have no exceptions, so a failed CHECK is recorded and the test carries on
+*/
+namespace Test {
+    struct Case {
+        const char *name;
+        std::function<void()> run;
+    };
+
+    std::vector<Case> &get_cases();
+
+    struct Register {
+        Register(const char *name, std::function<void()> run) { get_cases().push_back({name, run}); }
+    };
+
+    // record a failed check in the running test
+    void fail(const char *file, int line, const char *expr);
+    // running test can't run here, such as when its input files weren't supplied
+    void skip(const char *reason);
+}
+
+#define TEST(name) \
+    static void test_##name(); \
+    static Test::Register register_##name(#name, test_##name); \
+    static void test_##name()
+
+#define CHECK(expr) do { if (!(expr)) Test::fail(__FILE__, __LINE__, #expr); } while (0)
+// stop the test, later checks depend on this one
+#define REQUIRE(expr) do { if (!(expr)) { Test::fail(__FILE__, __LINE__, #expr); return; } } while (0)
\ No newline at end of file
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../source/Key.hpp"
+#include "../source/KeyScanner.hpp"
+#include "../source/MemorySource.hpp"
+#include "../source/xxhash64.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <switch.h>
+
+// read by diskio.c in place of SYSTEM storage, defined by KeyCollection.cpp
+extern FILE *storage_image;
+
+// fixtures shared by the host tests and the benchmark, all generated from a seed so runs repeat exactly
+namespace TestData {
+    // bytes in memory posing as process memory, with or without a view like a mapped dump
+    class BufferMemory : public MemorySource {
+    public:
+        BufferMemory(const byte_vector &data, bool has_view) : data(data), has_view(has_view) {}
+
+        size_t size() const override { return data.size(); }
+        bool read(u8 *dest, size_t offset, size_t length) override {
+            if ((offset > data.size()) || (length > data.size() - offset))
+                return false;
+            memcpy(dest, data.data() + offset, length);
+            return true;
+        }
+        const u8 *view() const override { return has_view ? data.data() : nullptr; }
+
+    private:
+        const byte_vector &data;
+        bool has_view;
+    };
+
+    // Key as KeyCollection declares it, constants computed from the key bytes themselves
+    inline Key make_key(const std::string &name, const byte_vector &bytes) {
+        byte_vector hash(0x20);
+        sha256CalculateHash(hash.data(), bytes.data(), bytes.size());
+        u16 byte_sum = 0;
+        for (size_t i = 0; i < SCAN_WINDOW; i++)
+            byte_sum += bytes[i];
+        return Key(name, XXHash64::hash(bytes.data(), SCAN_WINDOW, 0), byte_sum, hash, bytes.size());
+    }
+
+    inline byte_vector random_bytes(std::mt19937_64 &rng, size_t size) {
+        byte_vector bytes(size);
+        for (auto &b : bytes)
+            b = static_cast<u8>(rng());
+        return bytes;
+    }
+
+    // few distinct byte values so nearly every window passes the byte sum filter
+    inline byte_vector low_entropy_bytes(std::mt19937_64 &rng, size_t size) {
+        byte_vector bytes(size);
+        for (auto &b : bytes)
+            b = static_cast<u8>(rng() % 4);
+        return bytes;
+    }
+
+    /*
+        FAT16 volume holding files in one directory, like the ticket saves in /save of SYSTEM
+        clusters are single sectors so small files make a small volume, and each file is contiguous
+    */
+    inline byte_vector fat_image(const std::string &dir_name, const std::vector<std::pair<std::string, byte_vector>> &files) {
+        const size_t sector = 0x200, root_entries = 0x200;
+        auto put16 = [](u8 *p, u16 v) { p[0] = v; p[1] = v >> 8; };
+        auto put32 = [&](u8 *p, u32 v) { put16(p, v); put16(p + 2, v >> 16); };
+
+        size_t used = 1;
+        for (auto &f : files)
+            used += (f.second.size() + sector - 1) / sector;
+        // fatfs picks the FAT type from the cluster count alone, 0xff6 is the fewest FAT16 allows
+        size_t clusters = std::max<size_t>(used, 0x1000);
+        size_t fat_sectors = ((clusters + 2) * 2 + sector - 1) / sector;
+        size_t root_sector = 1 + fat_sectors, data_sector = root_sector + root_entries * 0x20 / sector;
+        byte_vector image((data_sector + clusters) * sector);
+
+        u8 *boot = image.data();
+        boot[0] = 0xeb, boot[1] = 0x3c, boot[2] = 0x90;
+        put16(boot + 11, sector);
+        boot[13] = 1;
+        put16(boot + 14, 1);
+        boot[16] = 1;
+        put16(boot + 17, root_entries);
+        boot[21] = 0xf8;
+        put16(boot + 22, fat_sectors);
+        put32(boot + 32, data_sector + clusters);
+        memcpy(boot + 54, "FAT16   ", 8);
+        boot[510] = 0x55, boot[511] = 0xaa;
+
+        u8 *fat = image.data() + sector;
+        put16(fat, 0xfff8);
+        put16(fat + 2, 0xffff);
+        u16 next_cluster = 2;
+        auto allocate = [&](size_t count) -> u16 {
+            if (count == 0)
+                return 0;
+            u16 first = next_cluster;
+            for (size_t i = 0; i < count; i++, next_cluster++)
+                put16(fat + next_cluster * 2, (i + 1 < count) ? next_cluster + 1 : 0xffff);
+            return first;
+        };
+        auto cluster_data = [&](u16 cluster) { return image.data() + (data_sector + cluster - 2) * sector; };
+        auto short_entry = [&](u8 *entry, const char *short_name, u8 attributes, u16 cluster, u32 size) {
+            memcpy(entry, short_name, 11);
+            entry[11] = attributes;
+            put16(entry + 26, cluster);
+            put32(entry + 28, size);
+        };
+
+        char short_name[12];
+        snprintf(short_name, sizeof(short_name), "%-11s", dir_name.c_str());
+        std::transform(short_name, short_name + 11, short_name, ::toupper);
+        u16 dir_cluster = allocate(1);
+        short_entry(image.data() + root_sector * sector, short_name, 0x10, dir_cluster, 0);
+
+        // files are named by long name entries ahead of a made up short name
+        u8 *entry = cluster_data(dir_cluster);
+        for (size_t i = 0; i < files.size(); i++) {
+            snprintf(short_name, sizeof(short_name), "LP%04u~1   ", static_cast<unsigned>(i % 10000));
+            u8 checksum = 0;
+            for (size_t j = 0; j < 11; j++)
+                checksum = ((checksum & 1) << 7) + (checksum >> 1) + static_cast<u8>(short_name[j]);
+
+            const std::string &name = files[i].first;
+            const size_t char_offsets[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+            size_t long_entries = (name.size() + 12) / 13;
+            for (size_t order = long_entries; order > 0; order--, entry += 0x20) {
+                entry[0] = order | ((order == long_entries) ? 0x40 : 0);
+                entry[11] = 0x0f;
+                entry[13] = checksum;
+                for (size_t j = 0; j < 13; j++) {
+                    size_t c = (order - 1) * 13 + j;
+                    put16(entry + char_offsets[j], (c < name.size()) ? name[c] : (c == name.size()) ? 0 : 0xffff);
+                }
+            }
+
+            const byte_vector &data = files[i].second;
+            u16 cluster = allocate((data.size() + sector - 1) / sector);
+            if (!data.empty())
+                std::copy(data.begin(), data.end(), cluster_data(cluster));
+            short_entry(entry, short_name, 0x20, cluster, data.size());
+            entry += 0x20;
+        }
+        return image;
+    }
+
+    // image mounted by fatfs through diskio.c while this is alive
+    struct StorageImage {
+        StorageImage(const byte_vector &image) {
+            storage_image = tmpfile();
+            fwrite(image.data(), 1, image.size(), storage_image);
+        }
+        ~StorageImage() {
+            fclose(storage_image);
+            storage_image = NULL;
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Test {
+    static size_t failures;
+    static const char *skip_reason;
+
+    std::vector<Case> &get_cases() {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    void fail(const char *file, int line, const char *expr) {
+        printf("    %s:%d: CHECK(%s) failed\n", file, line, expr);
+        failures++;
+    }
+
+    void skip(const char *reason) {
+        skip_reason = reason;
+    }
+}
+
+// run every test, or only those named on the command line
+int main(int argc, char **argv) {
+    size_t passed = 0, failed = 0, skipped = 0;
+
+    for (auto &c : Test::get_cases()) {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; i++)
+            selected |= !strcmp(argv[i], c.name);
+        if (!selected)
+            continue;
+
+        Test::failures = 0;
+        Test::skip_reason = nullptr;
+        c.run();
+        if (Test::failures > 0) {
+            printf("[FAIL] %s\n", c.name);
+            failed++;
+        } else if (Test::skip_reason != nullptr) {
+            printf("[SKIP] %s: %s\n", c.name, Test::skip_reason);
+            skipped++;
+        } else {
+            printf("[ OK ] %s\n", c.name);
+            passed++;
+        }
+    }
+
+    printf("%zu passed, %zu failed, %zu skipped\n", passed, failed, skipped);
+    return failed > 0;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/TicketBlockCache.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+struct BlockCacheFixture {
+    BlockCacheFixture() {
+        snprintf(path, sizeof(path), "/tmp/lockpick_ticket_blocks_%d.bin", getpid());
+    }
+    ~BlockCacheFixture() { remove(path); }
+
+    // cache file in the layout of TicketBlockCache::Header followed by the block lists
+    byte_vector make_file(u32 magic, const u64 (&save_sizes)[TICKET_SAVES], const u32 (&block_counts)[TICKET_SAVES], size_t blocks_written) {
+        byte_vector contents(0x20 + blocks_written * sizeof(u32));
+        memcpy(contents.data(), &magic, sizeof(magic));
+        memcpy(contents.data() + 0x8, save_sizes, sizeof(save_sizes));
+        memcpy(contents.data() + 0x18, block_counts, sizeof(block_counts));
+        for (size_t i = 0; i < blocks_written; i++) {
+            u32 block = static_cast<u32>(i);
+            memcpy(contents.data() + 0x20 + i * sizeof(u32), &block, sizeof(block));
+        }
+        return contents;
+    }
+
+    void write(const byte_vector &contents) {
+        FILE *out = fopen(path, "wb");
+        fwrite(contents.data(), 1, contents.size(), out);
+        fclose(out);
+    }
+
+    // total blocks a fresh cache loads from the file
+    size_t loaded() {
+        TicketBlockCache cache(path);
+        cache.load();
+        size_t count = 0;
+        for (size_t i = 0; i < TICKET_SAVES; i++)
+            count += cache.get_blocks(i).size();
+        return count;
+    }
+
+    char path[64];
+};
+
+TEST(ticket_block_cache_loads_valid_file) {
+    BlockCacheFixture f;
+    CHECK(f.loaded() == 0);
+
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, {0x40 * TICKET_BLOCK_SIZE, 0x10 * TICKET_BLOCK_SIZE}, {3, 2}, 5));
+    TicketBlockCache cache(f.path);
+    cache.load();
+    REQUIRE(cache.get_blocks(0).size() == 3);
+    REQUIRE(cache.get_blocks(1).size() == 2);
+    CHECK(cache.get_blocks(0)[2] == 2);
+    CHECK(cache.get_blocks(1)[0] == 3);
+}
+
+TEST(ticket_block_cache_rejects_bad_files) {
+    BlockCacheFixture f;
+    const u64 sizes[TICKET_SAVES] = {0x40 * TICKET_BLOCK_SIZE, 0x10 * TICKET_BLOCK_SIZE};
+
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC ^ 1, sizes, {3, 2}, 5));
+    CHECK(f.loaded() == 0);
+
+    // counts read from the file must not drive an allocation before they are checked
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, sizes, {0xffffffff, 2}, 5));
+    CHECK(f.loaded() == 0);
+
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, {~0ull, ~0ull}, {TICKET_BLOCK_CACHE_MAX_BLOCKS + 1, 0}, 5));
+    CHECK(f.loaded() == 0);
+
+    // more blocks than the save holds
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, sizes, {3, 0x11}, 3 + 0x11));
+    CHECK(f.loaded() == 0);
+
+    // truncated and padded block lists
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, sizes, {3, 2}, 4));
+    CHECK(f.loaded() == 0);
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, sizes, {3, 2}, 6));
+    CHECK(f.loaded() == 0);
+
+    f.write(byte_vector(0x10));
+    CHECK(f.loaded() == 0);
+
+    f.write(f.make_file(TICKET_BLOCK_CACHE_MAGIC, sizes, {3, 2}, 5));
+    CHECK(f.loaded() == 5);
+}
\ No newline at end of file
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define OPENSSL_API_COMPAT 0x10100000L
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/TicketDecryptor.hpp"
+#include "../source/fatfs/ff.h"
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+// OAEP block of a 0x10 byte titlekey as RFC 8017 builds it, SHA-256 and an empty label
+static byte_vector oaep_encode(const u8 *seed, const u8 *titlekey) {
+    byte_vector db(0xdf, 0);
+    u8 empty_hash[0x20];
+    sha256CalculateHash(empty_hash, "", 0);
+    std::copy(empty_hash, empty_hash + 0x20, db.begin());
+    db[0xce] = 1;
+    std::copy(titlekey, titlekey + 0x10, db.begin() + 0xcf);
+
+    u8 mask[0xdf];
+    PKCS1_MGF1(mask, sizeof(mask), seed, 0x20, EVP_sha256());
+    for (size_t i = 0; i < db.size(); i++)
+        db[i] ^= mask[i];
+
+    u8 masked_seed[0x20];
+    PKCS1_MGF1(masked_seed, sizeof(masked_seed), db.data(), db.size(), EVP_sha256());
+    for (size_t i = 0; i < 0x20; i++)
+        masked_seed[i] ^= seed[i];
+
+    byte_vector M(0x100, 0);
+    std::copy(masked_seed, masked_seed + 0x20, M.begin() + 1);
+    std::copy(db.begin(), db.end(), M.begin() + 0x21);
+    return M;
+}
+
+TEST(mgf1_matches_openssl) {
+    std::mt19937_64 rng(0x4d474631);
+    for (size_t length : {1, 0x1f, 0x20, 0x21, 0xdf, 0x100}) {
+        byte_vector seed = TestData::random_bytes(rng, 0x20), dest = TestData::random_bytes(rng, length);
+        byte_vector expected(length);
+        PKCS1_MGF1(expected.data(), length, seed.data(), seed.size(), EVP_sha256());
+        for (size_t i = 0; i < length; i++)
+            expected[i] ^= dest[i];
+
+        TicketDecryptor::mgf1_xor(seed.data(), seed.size(), dest.data(), dest.size());
+        CHECK(dest == expected);
+    }
+}
+
+// fixed seed and titlekey, the encoding follows the spec step by step with OpenSSL's MGF1
+TEST(oaep_known_answer) {
+    u8 seed[0x20], titlekey[0x10];
+    for (size_t i = 0; i < sizeof(seed); i++)
+        seed[i] = static_cast<u8>(0xa0 + i);
+    for (size_t i = 0; i < sizeof(titlekey); i++)
+        titlekey[i] = static_cast<u8>(i * 0x11);
+
+    byte_vector M = oaep_encode(seed, titlekey);
+    u8 db[0xdf];
+    REQUIRE(TicketDecryptor::oaep_decode(M.data(), db));
+    CHECK(std::equal(titlekey, titlekey + 0x10, db + 0xcf));
+    CHECK(db[0xce] == 1);
+
+    // any change to the block breaks the label hash
+    for (size_t i : {0x01, 0x20, 0x21, 0x40}) {
+        byte_vector bad = M;
+        bad[i] ^= 0x01;
+        CHECK(!TicketDecryptor::oaep_decode(bad.data(), db));
+    }
+}
+
+// blocks padded by OpenSSL itself, with random seeds
+TEST(oaep_openssl_padding) {
+    std::mt19937_64 rng(0x4f414550);
+    for (size_t i = 0; i < 8; i++) {
+        byte_vector titlekey = TestData::random_bytes(rng, 0x10), M(0x100);
+        REQUIRE(RSA_padding_add_PKCS1_OAEP_mgf1(M.data(), M.size(), titlekey.data(), titlekey.size(),
+            nullptr, 0, EVP_sha256(), EVP_sha256()) == 1);
+        u8 db[0xdf];
+        CHECK(TicketDecryptor::oaep_decode(M.data(), db));
+        CHECK(std::equal(titlekey.begin(), titlekey.end(), db + 0xcf));
+    }
+}
+
+struct TicketFixture {
+    TicketFixture() {
+        RSA *key = RSA_new();
+        BIGNUM *e = BN_new();
+        BN_set_word(e, 65537);
+        RSA_generate_key_ex(key, 2048, e, nullptr);
+        const BIGNUM *n, *d;
+        RSA_get0_key(key, &n, nullptr, &d);
+        BN_bn2binpad(n, N, sizeof(N));
+        BN_bn2binpad(d, D, sizeof(D));
+        BN_free(e);
+        RSA_free(key);
+    }
+
+    // ticket block holding titlekey, encrypted to the fixture's keypair
+    byte_vector encrypt(std::mt19937_64 &rng, const byte_vector &titlekey) {
+        byte_vector seed = TestData::random_bytes(rng, 0x20), block(0x100);
+        byte_vector M = oaep_encode(seed.data(), titlekey.data());
+        const u8 E[3] = {1, 0, 1};
+        splUserExpMod(M.data(), N, E, sizeof(E), block.data());
+        return block;
+    }
+
+    u8 N[0x100], D[0x100];
+};
+
+// "rights id = titlekey" lines TitlekeyMap::save writes
+static std::string saved_titlekeys(const TitlekeyMap &titlekeys) {
+    FILE *file = tmpfile();
+    titlekeys.save(file);
+    std::string contents(ftell(file), '\0');
+    rewind(file);
+    contents.resize(fread(&contents[0], 1, contents.size(), file));
+    fclose(file);
+    return contents;
+}
+
+TEST(ticket_decryptor_pipeline) {
+    TicketFixture f;
+    std::mt19937_64 rng(0x5449434b);
+
+    const size_t count = 24;
+    std::vector<RightsId> rights_ids(count);
+    std::vector<byte_vector> titlekeys, blocks;
+    for (size_t i = 0; i < count; i++) {
+        byte_vector id = TestData::random_bytes(rng, 0x10);
+        std::copy(id.begin(), id.end(), rights_ids[i].c);
+        titlekeys.push_back(TestData::random_bytes(rng, 0x10));
+        blocks.push_back(f.encrypt(rng, titlekeys.back()));
+    }
+    // the last ticket is damaged and must not produce a titlekey
+    blocks.back()[0x80] ^= 0x01;
+    // a damaged copy of the first ticket comes ahead of the good one and must not block it
+    byte_vector damaged_copy = blocks[0];
+    damaged_copy[0x40] ^= 0x01;
+
+    // both modexp backends give the same titlekeys
+    for (bool local_exp_mod : {true, false}) {
+        TitlekeyMap map(rights_ids.data(), count);
+        TicketDecryptor decryptor(f.D, f.N, local_exp_mod, map);
+        decryptor.start();
+        decryptor.add(map.find(rights_ids[0].c), damaged_copy.data());
+        for (size_t i = 0; i < count; i++)
+            decryptor.add(map.find(rights_ids[i].c), blocks[i].data());
+        decryptor.finish();
+        CHECK(map.get_count() == count - 1);
+
+        std::string saved = saved_titlekeys(map);
+        for (size_t i = 0; i + 1 < count; i++) {
+            char key_hex[0x21];
+            for (size_t j = 0; j < 0x10; j++)
+                sprintf(key_hex + j * 2, "%02x", titlekeys[i][j]);
+            CHECK(saved.find(key_hex) != std::string::npos);
+        }
+    }
+}
+
+// personalized ticket save of 0x40 blocks, tickets are placed with put and read back through fatfs
+struct SaveFixture {
+    SaveFixture() : save(0x40 * TICKET_BLOCK_SIZE) {
+        snprintf(cache_path, sizeof(cache_path), "/tmp/lockpick_ticket_save_%d.bin", getpid());
+        std::mt19937_64 rng(0x53415645);
+        for (size_t i = 0; i < 12; i++) {
+            rights_ids.emplace_back();
+            byte_vector id = TestData::random_bytes(rng, 0x10);
+            std::copy(id.begin(), id.end(), rights_ids.back().c);
+            titlekeys.push_back(TestData::random_bytes(rng, 0x10));
+            blocks.push_back(ticket.encrypt(rng, titlekeys.back()));
+        }
+    }
+    ~SaveFixture() { remove(cache_path); }
+
+    // record of block holding titlekey_block for rights_id
+    void put(size_t block, size_t record, const u8 *rights_id, const byte_vector &titlekey_block) {
+        u8 *r = save.data() + block * TICKET_BLOCK_SIZE + record * TICKET_RECORD_SIZE;
+        const u32 signature_type = 0x10004;
+        memcpy(r, &signature_type, sizeof(signature_type));
+        std::copy(titlekey_block.begin(), titlekey_block.end(), r + 0x180);
+        std::copy(rights_id, rights_id + 0x10, r + 0x2a0);
+    }
+
+    // decrypt the save as KeyCollection does with a fresh map, returns blocks read
+    size_t run(TitlekeyMap &map) {
+        TestData::StorageImage storage(TestData::fat_image("save", {{"80000000000000e1", {}}, {"80000000000000e2", save}}));
+        FATFS fs;
+        FIL file;
+        if (f_mount(&fs, "", 1) || f_chdir("/save") || f_open(&file, "80000000000000e2", FA_READ | FA_OPEN_EXISTING))
+            return 0;
+
+        TicketBlockCache cache(cache_path);
+        cache.load();
+        TicketDecryptor decryptor(ticket.D, ticket.N, true, map);
+        size_t blocks_read = decryptor.decrypt_save(cache, file, 1);
+        cache.save();
+        f_close(&file);
+        f_mount(NULL, "", 0);
+        return blocks_read;
+    }
+
+    // every titlekey is in the titlekeys map saves
+    bool all_found(const TitlekeyMap &map) {
+        std::string saved = saved_titlekeys(map);
+        for (auto &t : titlekeys) {
+            char key_hex[0x21];
+            for (size_t j = 0; j < 0x10; j++)
+                sprintf(key_hex + j * 2, "%02x", t[j]);
+            if (saved.find(key_hex) == std::string::npos)
+                return false;
+        }
+        return map.get_count() == titlekeys.size();
+    }
+
+    TicketFixture ticket;
+    char cache_path[64];
+    byte_vector save;
+    std::vector<RightsId> rights_ids;
+    std::vector<byte_vector> titlekeys, blocks;
+};
+
+TEST(decrypt_save_reads_cached_blocks) {
+    SaveFixture f;
+    for (size_t i = 0; i < 12; i++)
+        f.put((i < 4) ? 5 : (i < 8) ? 0x14 : 0x21, i % 4, f.rights_ids[i].c, f.blocks[i]);
+    // older copies and a ticket es doesn't report come after, the first run stops before them
+    for (size_t i = 0; i < 4; i++)
+        f.put(0x32, i, f.rights_ids[i].c, f.blocks[i]);
+    std::mt19937_64 rng(0x4f544852);
+    byte_vector unknown = TestData::random_bytes(rng, 0x10);
+    f.put(0x3c, 0, unknown.data(), f.blocks[0]);
+
+    TitlekeyMap first(f.rights_ids.data(), f.rights_ids.size());
+    CHECK(f.run(first) == 0x22);
+    CHECK(f.all_found(first));
+
+    // only the blocks that held a ticket are read on the next run
+    TitlekeyMap second(f.rights_ids.data(), f.rights_ids.size());
+    CHECK(f.run(second) == 3);
+    CHECK(f.all_found(second));
+}
+
+TEST(decrypt_save_retries_failed_copies) {
+    SaveFixture f;
+    for (size_t i = 0; i < 11; i++)
+        f.put(1 + i / 4, i % 4, f.rights_ids[i].c, f.blocks[i]);
+    // a damaged copy of the last ticket comes first and covers its slot until it fails
+    byte_vector damaged = f.blocks[11];
+    damaged[0x40] ^= 0x01;
+    f.put(3, 3, f.rights_ids[11].c, damaged);
+    f.put(0x30, 0, f.rights_ids[11].c, f.blocks[11]);
+
+    TitlekeyMap map(f.rights_ids.data(), f.rights_ids.size());
+    // blocks up to the damaged copy, then the whole save for the good one
+    CHECK(f.run(map) == 4 + 0x40);
+    CHECK(f.all_found(map));
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Test.hpp"
+#include "TestData.hpp"
+
+#include "../source/TitlekeyMap.hpp"
+
+#include <atomic>
+#include <thread>
+
+static std::vector<RightsId> random_rights_ids(std::mt19937_64 &rng, size_t count) {
+    std::vector<RightsId> ids(count);
+    for (auto &id : ids) {
+        byte_vector bytes = TestData::random_bytes(rng, 0x10);
+        std::copy(bytes.begin(), bytes.end(), id.c);
+    }
+    return ids;
+}
+
+TEST(titlekey_map_find) {
+    std::mt19937_64 rng(0x4d4150);
+    std::vector<RightsId> ids = random_rights_ids(rng, 64);
+    // es lists some ids twice
+    ids.push_back(ids[3]);
+    TitlekeyMap map(ids.data(), ids.size());
+
+    for (auto &id : ids)
+        CHECK(map.find(id.c) != TITLEKEY_NOT_FOUND);
+    RightsId missing = random_rights_ids(rng, 1)[0];
+    CHECK(map.find(missing.c) == TITLEKEY_NOT_FOUND);
+}
+
+// the ticket reader checks slots while decryptor threads set them, only the first copy of each is kept
+TEST(titlekey_map_concurrent_slots) {
+    std::mt19937_64 rng(0x534c4f54);
+    std::vector<RightsId> ids = random_rights_ids(rng, 256);
+    TitlekeyMap map(ids.data(), ids.size());
+    const u8 titlekey[0x10] = {};
+
+    // every slot is set by two threads
+    std::atomic<size_t> sets(0);
+    std::vector<std::thread> setters;
+    for (size_t t = 0; t < 4; t++) {
+        setters.emplace_back([&, t] {
+            for (size_t i = t / 2; i < ids.size(); i += 2)
+                sets += map.set(map.find(ids[i].c), titlekey);
+        });
+    }
+    // polled like get_titlekeys does while tickets are being decrypted
+    while (map.get_count() < map.get_slot_count()) {
+        for (auto &id : ids)
+            map.is_set(map.find(id.c));
+    }
+    for (auto &t : setters)
+        t.join();
+
+    CHECK(sets == ids.size());
+    CHECK(map.get_count() == ids.size());
+}
+
+TEST(titlekey_map_first_set_wins) {
+    std::mt19937_64 rng(0x46495253);
+    std::vector<RightsId> ids = random_rights_ids(rng, 1);
+    TitlekeyMap map(ids.data(), ids.size());
+    const u8 first[0x10] = {1}, second[0x10] = {2};
+
+    CHECK(!map.is_set(0));
+    CHECK(map.set(0, first));
+    CHECK(!map.set(0, second));
+    CHECK(map.is_set(0) && (map.get_count() == 1));
+}
\ No newline at end of file
@@ -14,12 +14,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "Stopwatch.hpp"
+#pragma once
 
-void Stopwatch::start() {
-    clock_gettime(CLOCK_REALTIME, &start_time);
-}
-
-void Stopwatch::stop() {
-    clock_gettime(CLOCK_REALTIME, &end_time);
-}
\ No newline at end of file
+#define __bswap16 __builtin_bswap16
+#define __bswap32 __builtin_bswap32
+#define __bswap64 __builtin_bswap64
\ No newline at end of file
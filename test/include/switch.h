@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+    host stand-in for libnx so the parts of Lockpick that don't need a console can be tested
+    crypto is real, services and debug svcs fail as if permission was denied
+*/
+
+#pragma once
+
+#include <switch/types.h>
+#include <switch/crypto/aes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_HASH_SIZE 0x20
+
+typedef struct {
+    u32 h[8];
+    u64 bits;
+    u8 block[0x40];
+    size_t block_size;
+} Sha256Context;
+
+void sha256ContextCreate(Sha256Context *out);
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size);
+void sha256ContextGetHash(Sha256Context *ctx, void *dst);
+void sha256CalculateHash(void *dst, const void *src, size_t size);
+
+// svc
+
+typedef enum {
+    Perm_R = BIT(0),
+    Perm_W = BIT(1),
+    Perm_X = BIT(2),
+} Permission;
+
+typedef enum {
+    MemType_CodeStatic = 0x03,
+    MemType_Heap = 0x05,
+} MemoryType;
+
+typedef struct {
+    u64 addr;
+    u64 size;
+    u32 type;
+    u32 attr;
+    u32 perm;
+    u32 ipc_refcount;
+    u32 device_refcount;
+    u32 padding;
+} MemoryInfo;
+
+Result svcDebugActiveProcess(Handle *debug, u64 processID);
+Result svcGetDebugEvent(u8 *event_out, Handle debug);
+Result svcGetProcessList(u32 *num_out, u64 *pids_out, u32 max_pids);
+Result svcQueryDebugProcessMemory(MemoryInfo *meminfo_ptr, u32 *pageinfo, Handle debug, u64 addr);
+Result svcReadDebugProcessMemory(void *buffer, Handle debug, u64 addr, u64 size);
+Result svcCloseHandle(Handle handle);
+bool envIsSyscallHinted(u32 svc);
+bool kernelAbove200(void);
+
+// services
+
+typedef struct {
+    u64 pid;
+    u64 process_id;
+} FsStorage;
+
+typedef enum {
+    FsBisPartitionId_BootPartition1Root = 0,
+    FsBisPartitionId_System = 31,
+} FsBisPartitionId;
+
+Result fsOpenBisStorage(FsStorage *out, FsBisPartitionId partition_id);
+Result fsStorageRead(FsStorage *s, s64 off, void *buf, u64 read_size);
+Result fsStorageGetSize(FsStorage *s, s64 *out);
+void fsStorageClose(FsStorage *s);
+
+typedef struct {
+    u8 major;
+    u8 minor;
+    u8 micro;
+    u8 padding1;
+    u8 revision_major;
+    u8 revision_minor;
+    u8 padding2;
+    u8 padding3;
+    char platform[0x20];
+    char version_hash[0x40];
+    char display_version[0x18];
+    char display_title[0x80];
+} SetSysFirmwareVersion;
+
+Result setsysInitialize(void);
+void setsysExit(void);
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion *out);
+
+typedef struct {
+    u8 key[0x240];
+} SetCalRsa2048DeviceKey;
+
+Result setcalInitialize(void);
+void setcalExit(void);
+Result setcalGetEticketDeviceKey(SetCalRsa2048DeviceKey *out);
+
+typedef enum {
+    SplConfigItem_NewKeyGeneration = 13,
+} SplConfigItem;
+
+Result splInitialize(void);
+void splExit(void);
+Result splGetConfig(SplConfigItem config_item, u64 *out_config);
+Result splUserExpMod(const void *input, const void *modulus, const void *exp, size_t exp_size, void *dst);
+Result splCryptoInitialize(void);
+void splCryptoExit(void);
+Result splCryptoGenerateAesKek(const void *wrapped_kek, u32 key_generation, u32 option, void *out_sealed_kek);
+Result splCryptoGenerateAesKey(const void *sealed_kek, const void *wrapped_key, void *out_sealed_key);
+Result splFsInitialize(void);
+void splFsExit(void);
+Result splFsGenerateSpecificAesKey(const void *wrapped_key, u32 key_generation, u32 option, void *out_sealed_key);
+
+Result pmdmntInitialize(void);
+void pmdmntExit(void);
+Result pmdmntGetProcessId(u64 *pid_out, u64 program_id);
+
+typedef struct {
+    u8 build_id[0x20];
+    u64 base_address;
+    u64 size;
+} LoaderModuleInfo;
+
+Result ldrDmntInitialize(void);
+void ldrDmntExit(void);
+Result ldrDmntGetProcessModuleInfo(u64 pid, LoaderModuleInfo *out_module_infos, size_t max_out_modules, s32 *num_out);
+
+// display and input
+
+typedef enum {
+    PIXEL_FORMAT_RGBA_8888 = 1,
+} PixelFormat;
+
+typedef struct {
+    u32 width;
+    u32 height;
+    u32 stride;
+    void *buf;
+} Framebuffer;
+
+typedef struct NWindow NWindow;
+
+NWindow *nwindowGetDefault(void);
+Result framebufferCreate(Framebuffer *fb, NWindow *win, u32 width, u32 height, PixelFormat format, u32 num_fbs);
+Result framebufferMakeLinear(Framebuffer *fb);
+void *framebufferBegin(Framebuffer *fb, u32 *out_stride);
+void framebufferEnd(Framebuffer *fb);
+void framebufferClose(Framebuffer *fb);
+
+typedef enum {
+    PlSharedFontType_Standard = 0,
+} PlSharedFontType;
+
+typedef struct {
+    u32 type;
+    u32 offset;
+    u32 size;
+    void *address;
+} PlFontData;
+
+Result plInitialize(void);
+void plExit(void);
+Result plGetSharedFontByType(PlFontData *font, PlSharedFontType shared_font_type);
+
+typedef enum {
+    CONTROLLER_P1_AUTO = 10,
+} HidControllerID;
+
+#define KEY_PLUS BIT(10)
+
+void hidScanInput(void);
+u64 hidKeysDown(HidControllerID id);
+
+bool appletMainLoop(void);
+Result appletLockExit(void);
+Result appletUnlockExit(void);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
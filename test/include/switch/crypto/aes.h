@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <switch/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// expanded key schedule, opaque to callers as on the console
+typedef struct {
+    u8 round_keys[15][0x10];
+    int rounds;
+    bool is_encryptor;
+} Aes128Context;
+
+typedef struct {
+    u8 key[0x10];
+    u8 ctr[0x10];
+    u8 enc_ctr_buffer[0x10];
+    size_t buffer_offset;
+} Aes128CtrContext;
+
+void aes128ContextCreate(Aes128Context *out, const void *key, bool is_encryptor);
+void aes128EncryptBlock(const Aes128Context *ctx, void *dst, const void *src);
+void aes128DecryptBlock(const Aes128Context *ctx, void *dst, const void *src);
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr);
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size);
+
+void cmacAes128CalculateMac(void *dst, const void *key, const void *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -16,15 +16,4 @@
 
 #pragma once
 
-#include <time.h>
-
-class Stopwatch {
-public:
-    void start();
-    void stop();
-
-    float get_elapsed() const { return (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0; };
-
-private:
-    struct timespec start_time, end_time;
-};
\ No newline at end of file
+#include <switch/types.h>
\ No newline at end of file
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2018 shchmue
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// libnx calls made by Lockpick, crypto through OpenSSL and everything needing a console failing
+
+#define OPENSSL_API_COMPAT 0x10100000L
+
+#include <string.h>
+
+#include <openssl/aes.h>
+#include <openssl/bn.h>
+#include <openssl/cmac.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include <switch.h>
+
+// any nonzero result reads as failure
+#define HOST_RESULT_UNAVAILABLE 0x1
+
+static_assert(sizeof(Aes128Context) >= sizeof(AES_KEY), "Aes128Context can't hold an AES_KEY");
+static_assert(sizeof(Sha256Context) >= sizeof(SHA256_CTX), "Sha256Context can't hold a SHA256_CTX");
+
+void aes128ContextCreate(Aes128Context *out, const void *key, bool is_encryptor) {
+    AES_KEY *k = reinterpret_cast<AES_KEY *>(out);
+    if (is_encryptor)
+        AES_set_encrypt_key(static_cast<const u8 *>(key), 128, k);
+    else
+        AES_set_decrypt_key(static_cast<const u8 *>(key), 128, k);
+}
+
+void aes128EncryptBlock(const Aes128Context *ctx, void *dst, const void *src) {
+    AES_encrypt(static_cast<const u8 *>(src), static_cast<u8 *>(dst), reinterpret_cast<const AES_KEY *>(ctx));
+}
+
+void aes128DecryptBlock(const Aes128Context *ctx, void *dst, const void *src) {
+    AES_decrypt(static_cast<const u8 *>(src), static_cast<u8 *>(dst), reinterpret_cast<const AES_KEY *>(ctx));
+}
+
+void aes128CtrContextCreate(Aes128CtrContext *out, const void *key, const void *ctr) {
+    memcpy(out->key, key, sizeof(out->key));
+    memcpy(out->ctr, ctr, sizeof(out->ctr));
+    out->buffer_offset = 0;
+}
+
+void aes128CtrCrypt(Aes128CtrContext *ctx, void *dst, const void *src, size_t size) {
+    AES_KEY k;
+    AES_set_encrypt_key(ctx->key, 128, &k);
+    const u8 *in = static_cast<const u8 *>(src);
+    u8 *out = static_cast<u8 *>(dst);
+    for (size_t i = 0; i < size; i++) {
+        if (ctx->buffer_offset == 0) {
+            AES_encrypt(ctx->ctr, ctx->enc_ctr_buffer, &k);
+            for (int j = 0x10 - 1; j >= 0 && ++ctx->ctr[j] == 0; j--);
+        }
+        out[i] = in[i] ^ ctx->enc_ctr_buffer[ctx->buffer_offset];
+        ctx->buffer_offset = (ctx->buffer_offset + 1) % 0x10;
+    }
+}
+
+void cmacAes128CalculateMac(void *dst, const void *key, const void *src, size_t size) {
+    size_t mac_size;
+    CMAC_CTX *ctx = CMAC_CTX_new();
+    CMAC_Init(ctx, key, 0x10, EVP_aes_128_cbc(), nullptr);
+    CMAC_Update(ctx, src, size);
+    CMAC_Final(ctx, static_cast<u8 *>(dst), &mac_size);
+    CMAC_CTX_free(ctx);
+}
+
+void sha256ContextCreate(Sha256Context *out) {
+    SHA256_Init(reinterpret_cast<SHA256_CTX *>(out));
+}
+
+void sha256ContextUpdate(Sha256Context *ctx, const void *src, size_t size) {
+    SHA256_Update(reinterpret_cast<SHA256_CTX *>(ctx), src, size);
+}
+
+void sha256ContextGetHash(Sha256Context *ctx, void *dst) {
+    SHA256_Final(static_cast<u8 *>(dst), reinterpret_cast<SHA256_CTX *>(ctx));
+}
+
+void sha256CalculateHash(void *dst, const void *src, size_t size) {
+    SHA256(static_cast<const u8 *>(src), size, static_cast<u8 *>(dst));
+}
+
+// the security monitor's exponentiation, 2048-bit big endian
+Result splUserExpMod(const void *input, const void *modulus, const void *exp, size_t exp_size, void *dst) {
+    BIGNUM *m = BN_bin2bn(static_cast<const u8 *>(input), 0x100, nullptr);
+    BIGNUM *n = BN_bin2bn(static_cast<const u8 *>(modulus), 0x100, nullptr);
+    BIGNUM *e = BN_bin2bn(static_cast<const u8 *>(exp), exp_size, nullptr);
+    BIGNUM *r = BN_new();
+    BN_CTX *ctx = BN_CTX_new();
+    int ok = BN_mod_exp(r, m, e, n, ctx) && (BN_bn2binpad(r, static_cast<u8 *>(dst), 0x100) == 0x100);
+    BN_CTX_free(ctx);
+    BN_free(r);
+    BN_free(e);
+    BN_free(n);
+    BN_free(m);
+    return ok ? 0 : HOST_RESULT_UNAVAILABLE;
+}
+
+Result svcDebugActiveProcess(Handle *debug, u64 processID) { *debug = INVALID_HANDLE; return HOST_RESULT_UNAVAILABLE; }
+Result svcGetDebugEvent(u8 *event_out, Handle debug) { return HOST_RESULT_UNAVAILABLE; }
+Result svcGetProcessList(u32 *num_out, u64 *pids_out, u32 max_pids) { *num_out = 0; return HOST_RESULT_UNAVAILABLE; }
+Result svcQueryDebugProcessMemory(MemoryInfo *meminfo_ptr, u32 *pageinfo, Handle debug, u64 addr) {
+    *meminfo_ptr = {};
+    return HOST_RESULT_UNAVAILABLE;
+}
+Result svcReadDebugProcessMemory(void *buffer, Handle debug, u64 addr, u64 size) { return HOST_RESULT_UNAVAILABLE; }
+Result svcCloseHandle(Handle handle) { return 0; }
+bool envIsSyscallHinted(u32 svc) { return false; }
+bool kernelAbove200(void) { return true; }
+
+Result fsOpenBisStorage(FsStorage *out, FsBisPartitionId partition_id) { return HOST_RESULT_UNAVAILABLE; }
+Result fsStorageRead(FsStorage *s, s64 off, void *buf, u64 read_size) { return HOST_RESULT_UNAVAILABLE; }
+Result fsStorageGetSize(FsStorage *s, s64 *out) { *out = 0; return HOST_RESULT_UNAVAILABLE; }
+void fsStorageClose(FsStorage *s) {}
+
+Result setsysInitialize(void) { return 0; }
+void setsysExit(void) {}
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion *out) {
+    *out = {};
+    out->major = 9;
+    out->minor = 1;
+    return 0;
+}
+
+Result setcalInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void setcalExit(void) {}
+Result setcalGetEticketDeviceKey(SetCalRsa2048DeviceKey *out) { return HOST_RESULT_UNAVAILABLE; }
+
+Result splInitialize(void) { return 0; }
+void splExit(void) {}
+Result splGetConfig(SplConfigItem config_item, u64 *out_config) { *out_config = 0; return HOST_RESULT_UNAVAILABLE; }
+Result splCryptoInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void splCryptoExit(void) {}
+Result splCryptoGenerateAesKek(const void *wrapped_kek, u32 key_generation, u32 option, void *out_sealed_kek) { return HOST_RESULT_UNAVAILABLE; }
+Result splCryptoGenerateAesKey(const void *sealed_kek, const void *wrapped_key, void *out_sealed_key) { return HOST_RESULT_UNAVAILABLE; }
+Result splFsInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void splFsExit(void) {}
+Result splFsGenerateSpecificAesKey(const void *wrapped_key, u32 key_generation, u32 option, void *out_sealed_key) { return HOST_RESULT_UNAVAILABLE; }
+
+Result pmdmntInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void pmdmntExit(void) {}
+Result pmdmntGetProcessId(u64 *pid_out, u64 program_id) { *pid_out = 0; return HOST_RESULT_UNAVAILABLE; }
+
+Result ldrDmntInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void ldrDmntExit(void) {}
+Result ldrDmntGetProcessModuleInfo(u64 pid, LoaderModuleInfo *out_module_infos, size_t max_out_modules, s32 *num_out) {
+    *num_out = 0;
+    return HOST_RESULT_UNAVAILABLE;
+}
+
+// drawing goes to a plain buffer nobody looks at
+NWindow *nwindowGetDefault(void) { return nullptr; }
+
+Result framebufferCreate(Framebuffer *fb, NWindow *win, u32 width, u32 height, PixelFormat format, u32 num_fbs) {
+    fb->width = width;
+    fb->height = height;
+    fb->stride = width * sizeof(u32);
+    fb->buf = new u8[fb->stride * height]();
+    return 0;
+}
+Result framebufferMakeLinear(Framebuffer *fb) { return 0; }
+void *framebufferBegin(Framebuffer *fb, u32 *out_stride) {
+    *out_stride = fb->stride;
+    return fb->buf;
+}
+void framebufferEnd(Framebuffer *fb) {}
+void framebufferClose(Framebuffer *fb) {
+    delete[] static_cast<u8 *>(fb->buf);
+    fb->buf = nullptr;
+}
+
+Result plInitialize(void) { return HOST_RESULT_UNAVAILABLE; }
+void plExit(void) {}
+Result plGetSharedFontByType(PlFontData *font, PlSharedFontType shared_font_type) {
+    *font = {};
+    return HOST_RESULT_UNAVAILABLE;
+}
+
+void hidScanInput(void) {}
+u64 hidKeysDown(HidControllerID id) { return KEY_PLUS; }
+
+bool appletMainLoop(void) { return false; }
+Result appletLockExit(void) { return 0; }
+Result appletUnlockExit(void) { return 0; }
+
+// ES isn't reachable either, stands in for source/nx/es.c
+extern "C" {
+    #include "../source/nx/es.h"
+}
+
+Result esInitialize() { return HOST_RESULT_UNAVAILABLE; }
+void esExit() {}
+Result esCountCommonTicket(u32 *num_tickets) { *num_tickets = 0; return HOST_RESULT_UNAVAILABLE; }
+Result esCountPersonalizedTicket(u32 *num_tickets) { *num_tickets = 0; return HOST_RESULT_UNAVAILABLE; }
+Result esListCommonTicket(u32 *numRightsIdsWritten, RightsId *outBuf, size_t bufSize) { *numRightsIdsWritten = 0; return HOST_RESULT_UNAVAILABLE; }
+Result esListPersonalizedTicket(u32 *numRightsIdsWritten, RightsId *outBuf, size_t bufSize) { *numRightsIdsWritten = 0; return HOST_RESULT_UNAVAILABLE; }
\ No newline at end of file